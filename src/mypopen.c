@@ -1,4 +1,72 @@
-#include "mypopen.h"
+#define _GNU_SOURCE /* pipe2, memfd_create */
+
+#include "mypopen_private.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+/**
+ * the longest delay between two checks for the child process if no pidfd is available
+ */
+#define MAX_POLL_DELAY_MS 50
+
+/**
+ * the size of the stdio buffer of the stream returned by mypopen
+ */
+#define STREAM_BUFFER_SIZE 8192
+
+/**
+ * the target of ioprio_set for a single process (IOPRIO_WHO_PROCESS of linux/ioprio.h)
+ */
+#define IOPRIO_WHO_PROCESS 1
+
+/**
+ * the position of the class in an I/O priority (IOPRIO_CLASS_SHIFT of linux/ioprio.h)
+ */
+#define IOPRIO_CLASS_SHIFT 13
+
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP 0x200000000ULL /* linux/sched.h, since Linux 5.7 */
+#endif
+
+/**
+ * the arguments of clone3 as far as they are used here (struct clone_args of linux/sched.h)
+ */
+struct clone3_args {
+  uint64_t flags;        /* CLONE_* flags */
+  uint64_t pidfd;        /* where to store a pidfd with CLONE_PIDFD */
+  uint64_t child_tid;    /* where to store the thread id in the child */
+  uint64_t parent_tid;   /* where to store the thread id in the parent */
+  uint64_t exit_signal;  /* the signal sent to the parent when the child terminates */
+  uint64_t stack;        /* the stack of the child or 0 to share it like fork */
+  uint64_t stack_size;   /* the size of stack */
+  uint64_t tls;          /* the thread local storage with CLONE_SETTLS */
+  uint64_t set_tid;      /* the thread ids to use in the pid namespaces */
+  uint64_t set_tid_size; /* the number of set_tid */
+  uint64_t cgroup;       /* the cgroup directory with CLONE_INTO_CGROUP */
+};
+
+/**
+ * the escalation used by mypclose_timeout if the caller does not supply one
+ */
+static const struct mypclose_step default_steps[] = {{SIGTERM, 1000}, {SIGKILL, -1}};
+
+/**
+ * the escalation used by mypclose_abort
+ */
+static const struct mypclose_step abort_steps[] = {{SIGKILL, -1}};
 
 /**
  * a global variable containing the process id returned by fork
@@ -10,6 +78,88 @@ static pid_t pid = -1;
  */
 static FILE *global_stream = NULL;
 
+/**
+ * a global variable containing the stdio buffer of global_stream or NULL if stdio allocates it
+ */
+static char *global_buffer = NULL;
+
+/**
+ * a global variable containing the MYPOPEN_* flags the child was created with
+ */
+static unsigned int global_flags = 0;
+
+/**
+ * a global variable set if the stream replays cached output instead of reading from a child
+ */
+static int global_cached = 0;
+
+/**
+ * @brief reset the global variables
+ */
+static void reset_globals(void) {
+  if (pid != -1) {
+    mypopen_stats_released();
+  }
+  pid = -1;
+  global_stream = NULL;
+  global_flags = 0;
+  global_cached = 0;
+}
+
+/**
+ * @brief get the number of mypopen streams whose child has terminated but not been waited for
+ *
+ * @returns 1 if the child of the stream is a zombie, otherwise 0
+ */
+unsigned int mypopen_stream_zombies(void) {
+  pid_t child_pid = pid;
+  siginfo_t info;
+
+  if (child_pid == -1) {
+    return 0;
+  }
+
+  /* WNOWAIT leaves the child to be reaped by mypclose */
+  info.si_pid = 0;
+  return waitid(P_PID, (id_t)child_pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 &&
+         info.si_pid == child_pid;
+}
+
+/**
+ * @brief get the target for signals to the child process
+ *
+ * @returns the process group of the child if it has one, otherwise its process id
+ */
+static pid_t signal_target(void) {
+  return (global_flags & MYPOPEN_SETPGRP) ? -pid : pid;
+}
+
+/**
+ * @brief initialize the options for mypopen_ex to their defaults
+ *
+ * @param attr the options to be initialized
+ */
+void mypopen_attr_init(struct mypopen_attr *attr) {
+  attr->flags = 0;
+  attr->inputs = NULL;
+  attr->ninputs = 0;
+  attr->stdin_data = NULL;
+  attr->stdin_size = 0;
+  attr->envp = NULL;
+  attr->cwd = NULL;
+  attr->argv = NULL;
+  attr->cpus = NULL;
+  attr->cpus_size = 0;
+  attr->sched_policy = 0;
+  attr->sched_priority = 0;
+  attr->nice = 0;
+  attr->cgroup = NULL;
+  attr->limits = NULL;
+  attr->nlimits = 0;
+  attr->ioprio_class = 0;
+  attr->ioprio_level = 0;
+}
+
 /**
  * @brief initiate a pipe stream to or from a process
  *
@@ -19,25 +169,378 @@ static FILE *global_stream = NULL;
  * @returns a file pointer or NULL in case of error
  */
 FILE *mypopen(const char *command, const char *type) {
-  int pipe_ends[2];
-  int parent, child;
+  return mypopen_ex(command, type, NULL);
+}
 
-  /* check if already open */
-  if (global_stream != NULL) {
-    errno = EAGAIN;
-    return NULL;
+/**
+ * @brief apply the flags of the options that concern the calling process
+ *
+ * @param flags the MYPOPEN_* flags, adjusted to the ones implied
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int prepare_parent(unsigned int *flags) {
+  /* the subreaper implies a process group to find the adopted processes */
+  if (*flags & MYPOPEN_SUBREAPER) {
+    *flags |= MYPOPEN_SETPGRP;
+    if (prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0) == -1) {
+      /* errno is set by prctl */
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief create a sealed file in memory holding the data for the standard input of a child
+ *
+ * @param attr the options for the child process (may be NULL)
+ * @param input where to store the file descriptor or -1 if there is no such data
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int create_input_file(const struct mypopen_attr *attr, int *input) {
+  const char *data;
+  size_t done = 0;
+  int saved_errno;
+  int seal = 1;
+  int fd;
+
+  *input = -1;
+  if (attr == NULL || attr->stdin_data == NULL) {
+    return 0;
+  }
+
+  if ((fd = memfd_create("mypopen-stdin", MFD_CLOEXEC | MFD_ALLOW_SEALING)) == -1) {
+    if (errno != ENOSYS && errno != EINVAL) {
+      /* errno is set by memfd_create */
+      return -1;
+    }
+    /* kernels before 3.17 cannot seal, a file nobody else can open has to do */
+    seal = 0;
+    if ((fd = open(P_tmpdir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600)) == -1) {
+      /* errno is set by open */
+      return -1;
+    }
+  }
+
+  for (data = attr->stdin_data; done < attr->stdin_size;) {
+    ssize_t n = write(fd, data + done, attr->stdin_size - done);
+
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      goto error;
+    }
+    done += (size_t)n;
+  }
+
+  /* the child reads from the start of the file, which must not change anymore */
+  if (lseek(fd, 0, SEEK_SET) == -1 ||
+      (seal &&
+       fcntl(fd, F_ADD_SEALS, F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) == -1)) {
+    goto error;
+  }
+
+  *input = fd;
+  mypopen_stats_stdin(attr->stdin_size);
+  return 0;
+
+error:
+  saved_errno = errno;
+  close(fd);
+  errno = saved_errno;
+  return -1;
+}
+
+#ifdef SYS_clone3
+/**
+ * @brief check whether clone3 knows CLONE_INTO_CGROUP, telling its EINVAL apart
+ *
+ * Kernels before 5.7 reject the unknown flag with EINVAL before anything
+ * else. Newer ones get as far as the cgroup and reject a descriptor that is
+ * not open with EBADF, so no process is created either way.
+ *
+ * @returns 1 if the flag is known, otherwise 0
+ */
+static int clone_into_cgroup_known(void) {
+  struct clone3_args args;
+
+  memset(&args, 0, sizeof(args));
+  args.flags = CLONE_INTO_CGROUP;
+  args.exit_signal = SIGCHLD;
+  args.cgroup = INT_MAX;
+  return syscall(SYS_clone3, &args, sizeof(args)) == -1 && errno == EBADF;
+}
+#endif
+
+/**
+ * @brief fork the calling process, placing the child in the cgroup of the options
+ *
+ * With a cgroup the child is created in it by clone3 with CLONE_INTO_CGROUP,
+ * so it never runs (or allocates) outside of it. If the kernel lacks that,
+ * the child moves itself by writing to cgroup.procs before anything else.
+ * Should that fail, the child sends errno over a close-on-exec pipe and
+ * exits, and the parent reaps it and fails with that errno, just as if
+ * clone3 had failed.
+ *
+ * glibc has no wrapper for clone3, so the raw system call bypasses what fork
+ * does around it: pthread_atfork handlers do not run and the locks of malloc
+ * and stdio are not reset in the child. Another thread may hold them at the
+ * time of the call, so until exec the child may only call async-signal-safe
+ * functions (exec_child does just that, no malloc, stdio or locale).
+ *
+ * @returns the process id of the child in the parent, 0 in the child or -1 in case of error
+ */
+static pid_t fork_child(const struct mypopen_attr *attr) {
+  int error_pipe[2];
+  int child_errno;
+  int cgroup;
+  int saved_errno;
+  pid_t child_pid;
+  ssize_t n;
+
+  if (attr == NULL || attr->cgroup == NULL) {
+    return fork();
+  }
+
+  if ((cgroup = open(attr->cgroup, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1) {
+    /* errno is set by open */
+    return -1;
+  }
+
+#ifdef SYS_clone3
+  {
+    struct clone3_args args;
+
+    memset(&args, 0, sizeof(args));
+    args.flags = CLONE_INTO_CGROUP;
+    args.exit_signal = SIGCHLD;
+    args.cgroup = (uint64_t)cgroup;
+    child_pid = (pid_t)syscall(SYS_clone3, &args, sizeof(args));
+  }
+  if (child_pid == -1 && errno == EINVAL && clone_into_cgroup_known()) {
+    /* a real error, such as a cgroup that cannot take processes */
+    errno = EINVAL;
+  }
+  if (child_pid != -1 || (errno != ENOSYS && errno != E2BIG && errno != EINVAL)) {
+    /* placed by the kernel (ENOSYS, E2BIG and EINVAL mean clone3 or the flag is unknown) */
+    saved_errno = errno;
+    close(cgroup);
+    errno = saved_errno;
+    return child_pid;
+  }
+#endif
+
+  if (pipe2(error_pipe, O_CLOEXEC) == -1) {
+    saved_errno = errno;
+    close(cgroup);
+    /* errno was set by pipe2 */
+    errno = saved_errno;
+    return -1;
+  }
+
+  if ((child_pid = fork()) == 0) {
+    int procs = openat(cgroup, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+
+    close(error_pipe[0]);
+    /* 0 stands for the writing process */
+    if (procs == -1 || write(procs, "0", 1) != 1) {
+      child_errno = errno;
+      /* the pipe is empty, so this never blocks */
+      while (write(error_pipe[1], &child_errno, sizeof(child_errno)) == -1 && errno == EINTR) {
+      }
+      _exit(1); /* catchall for general errors */
+    }
+    close(procs);
+    close(error_pipe[1]);
+    close(cgroup);
+    return 0;
+  }
+
+  saved_errno = errno;
+  close(cgroup);
+  close(error_pipe[1]);
+  if (child_pid == -1) {
+    close(error_pipe[0]);
+    /* errno was set by fork */
+    errno = saved_errno;
+    return -1;
+  }
+
+  /* end of file once the child is in place */
+  while ((n = read(error_pipe[0], &child_errno, sizeof(child_errno))) == -1 && errno == EINTR) {
+  }
+  close(error_pipe[0]);
+  if (n == (ssize_t)sizeof(child_errno)) {
+    while (waitpid(child_pid, NULL, 0) == -1 && errno == EINTR) {
+    }
+    errno = child_errno;
+    return -1;
+  }
+
+  return child_pid;
+}
+
+/**
+ * @brief set the CPU affinity, scheduling policy, nice value and I/O priority of the calling
+ *        process
+ *
+ * Called in the child process after fork, so the settings of the caller
+ * (which may be pinned to cores or run with a real-time policy) stay as
+ * they are.
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int set_scheduling(const struct mypopen_attr *attr, unsigned int flags) {
+  if (attr == NULL) {
+    return 0;
+  }
+  if (attr->cpus != NULL &&
+      sched_setaffinity(0, attr->cpus_size, (const cpu_set_t *)attr->cpus) == -1) {
+    /* errno is set by sched_setaffinity */
+    return -1;
+  }
+  if (flags & MYPOPEN_SETSCHED) {
+    struct sched_param param;
+
+    param.sched_priority = attr->sched_priority;
+    if (sched_setscheduler(0, attr->sched_policy, &param) == -1) {
+      /* errno is set by sched_setscheduler */
+      return -1;
+    }
+  }
+  /* last, so it applies under the policy set above */
+  if ((flags & MYPOPEN_SETNICE) && setpriority(PRIO_PROCESS, 0, attr->nice) == -1) {
+    /* errno is set by setpriority */
+    return -1;
+  }
+  if ((flags & MYPOPEN_SETIOPRIO) && (attr->ioprio_class < 0 || attr->ioprio_class > 7 ||
+                                      attr->ioprio_level < 0 || attr->ioprio_level > 7)) {
+    /* would spill into the other bits of the priority */
+    errno = EINVAL;
+    return -1;
+  }
+  if ((flags & MYPOPEN_SETIOPRIO) &&
+      syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+              attr->ioprio_class << IOPRIO_CLASS_SHIFT | attr->ioprio_level) == -1) {
+    /* errno is set by ioprio_set */
+    return -1;
   }
 
+  return 0;
+}
+
+/**
+ * @brief set the resource limits of the options for the calling process
+ *
+ * Called in the child process just before exec, the limits then apply to
+ * the command from its first instruction (and to its descendants), but not
+ * to the setup of the child.
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int set_limits(const struct mypopen_attr *attr) {
+  size_t i;
+
+  for (i = 0; attr != NULL && i < attr->nlimits; ++i) {
+    if (setrlimit(attr->limits[i].resource, &attr->limits[i].limit) == -1) {
+      /* errno is set by setrlimit */
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief set up the child process and execute the command (does not return)
+ *
+ * @param command the command to be executed
+ * @param attr the options for the child process (may be NULL)
+ * @param flags the MYPOPEN_* flags, including the ones implied
+ * @param fd the file descriptor to become target in the child
+ * @param target the standard file descriptor connected to fd
+ * @param input the file descriptor to become the standard input or -1
+ * @param program the program resolved for attr->argv
+ */
+__attribute__((noreturn)) static void exec_child(const char *command,
+                                                const struct mypopen_attr *attr,
+                                                unsigned int flags, int fd, int target,
+                                                int input, const struct program *program) {
+  if ((flags & MYPOPEN_SETPGRP) && setpgid(0, 0) == -1) {
+    _exit(1); /* catchall for general errors */
+  }
+  if (set_scheduling(attr, flags) == -1) {
+    _exit(1); /* catchall for general errors */
+  }
+  /* get the input out of the way if it happens to occupy the target */
+  if (input == target && (input = fcntl(input, F_DUPFD_CLOEXEC, STDERR_FILENO + 1)) == -1) {
+    _exit(1); /* catchall for general errors */
+  }
+  if (fd != target) {
+    if (dup2(fd, target) == -1) {
+      close(fd);
+      _exit(1); /* catchall for general errors */
+    }
+    close(fd);
+  } else if (fcntl(target, F_SETFD, 0) == -1) {
+    _exit(1); /* catchall for general errors */
+  }
+  if (input != -1) {
+    if (input != STDIN_FILENO) {
+      if (dup2(input, STDIN_FILENO) == -1) {
+        _exit(1); /* catchall for general errors */
+      }
+      close(input);
+    } else if (fcntl(STDIN_FILENO, F_SETFD, 0) == -1) {
+      _exit(1); /* catchall for general errors */
+    }
+  }
+  if (attr != NULL && attr->cwd != NULL && chdir(attr->cwd) == -1) {
+    _exit(1); /* catchall for general errors */
+  }
+  /* last, so a low limit such as RLIMIT_NOFILE cannot break the setup above */
+  if (set_limits(attr) == -1) {
+    _exit(1); /* catchall for general errors */
+  }
+  if (attr != NULL && attr->argv != NULL) {
+    /* no shell involved */
+    mypopen_program_exec(program, command, attr->argv, attr->envp != NULL ? attr->envp : environ);
+  } else if (attr != NULL && attr->envp != NULL) {
+    execle("/bin/sh", "sh", "-c", command, (char *)NULL, attr->envp);
+  } else {
+    execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+  }
+  /* reached only if exec failed */
+  _exit(127); /* command not found */
+}
+
+/**
+ * @brief create a child process executing a command with a pipe to or from it (see mypspawn)
+ */
+static pid_t spawn_child(const char *command, const char *type, const struct mypopen_attr *attr,
+                         int *fd) {
+  struct program program = {-1, ""};
+  int pipe_ends[2];
+  int parent, child;
+  int input;
+  int saved_errno;
+  unsigned int flags = attr != NULL ? attr->flags : 0;
+  pid_t child_pid;
+
   /* check the command input */
   if (command == NULL) {
     errno = EINVAL;
-    return NULL;
+    return -1;
   }
 
   /* check the type inout length */
   if (type[1] != '\0') {
     errno = EINVAL;
-    return NULL;
+    return -1;
   }
 
   /* process the type input */
@@ -52,98 +555,515 @@ FILE *mypopen(const char *command, const char *type) {
     break;
   default:
     errno = EINVAL;
-    return NULL;
+    return -1;
   }
 
-  /* create a pipe */
-  if (pipe(pipe_ends) == -1) {
-    /* errno is set by pipe */
-    return NULL;
+  if (attr != NULL && attr->argv != NULL && mypopen_program_resolve(command, &program) == -1) {
+    /* errno is set by mypopen_program_resolve */
+    return -1;
+  }
+
+  if (prepare_parent(&flags) == -1 || create_input_file(attr, &input) == -1) {
+    saved_errno = errno;
+    mypopen_program_release(&program);
+    /* errno was set by prepare_parent or create_input_file */
+    errno = saved_errno;
+    return -1;
+  }
+
+  if (input != -1 && child == STDIN_FILENO) {
+    /* the data takes the place of the pipe */
+    pipe_ends[parent] = -1;
+    pipe_ends[child] = input;
+    input = -1;
+  } else if (pipe2(pipe_ends, O_CLOEXEC) == -1) {
+    /* create a pipe, close-on-exec so other children do not inherit it */
+    saved_errno = errno;
+    if (input != -1) {
+      close(input);
+    }
+    mypopen_program_release(&program);
+    /* errno was set by pipe2 */
+    errno = saved_errno;
+    return -1;
   }
 
   /* create a child process */
-  switch (pid = fork()) {
+  switch (child_pid = fork_child(attr)) {
   /* error */
   case -1:
-    close(pipe_ends[parent]);
+    saved_errno = errno;
+    if (pipe_ends[parent] != -1) {
+      close(pipe_ends[parent]);
+    }
     close(pipe_ends[child]);
-    /* errno is set by fork */
-    return NULL;
+    if (input != -1) {
+      close(input);
+    }
+    mypopen_program_release(&program);
+    /* errno was set by fork */
+    errno = saved_errno;
+    return -1;
   /* child */
   case 0:
-    close(pipe_ends[parent]);
-    if (pipe_ends[child] != child) {
-      if (dup2(pipe_ends[child], child) == -1) {
-        close(pipe_ends[child]);
-        _exit(1); /* catchall for general errors */
-      }
-      close(pipe_ends[child]);
+    if (pipe_ends[parent] != -1) {
+      close(pipe_ends[parent]);
     }
-    execl("/bin/sh", "sh", "-c", command, NULL);
-    /* reached only if execl failed */
-    _exit(127); /* command not found */
+    exec_child(command, attr, flags, pipe_ends[child], child, input, &program);
   /* parent */
   default:
+    if (flags & MYPOPEN_SETPGRP) {
+      /* also done here so the group exists once we return, fails if already exec'ed */
+      setpgid(child_pid, child_pid);
+    }
     close(pipe_ends[child]);
-    if ((global_stream = fdopen(pipe_ends[parent], type)) == NULL) {
-      close(pipe_ends[parent]);
-      /* errno is set by fdopen */
-      return NULL;
+    if (input != -1) {
+      close(input);
     }
+    mypopen_program_release(&program);
+    *fd = pipe_ends[parent];
   }
 
-  return global_stream;
+  return child_pid;
 }
 
 /**
- * @brief close a pipe stream to or from a process
+ * @brief create a child process executing a command with a pipe to or from it
  *
- * @param stream the stream to be closed
+ * Unlike mypopen_ex this function keeps no state, so any number of children
+ * can be running at the same time. The pipe end of the caller is close-on-exec
+ * and the caller is responsible for closing it and for reaping the child
+ * (e.g. with waitpid).
  *
- * @returns the exit status of the process or -1 in case of error
+ * The options are described with struct mypopen_attr. Most of them are
+ * applied in the child, which exits with status 1 if one cannot be set; the
+ * function itself fails if the program of argv does not exist or the child
+ * cannot be placed in the cgroup.
+ *
+ * @param command the command to be executed
+ * @param type the I/O mode (r/w)
+ * @param attr the options for the child process (may be NULL)
+ * @param fd where to store the pipe end of the caller
+ *
+ * @returns the process id of the child or -1 in case of error
  */
-int mypclose(FILE *stream) {
-  pid_t wait_pid;
-  int status;
+pid_t mypspawn(const char *command, const char *type, const struct mypopen_attr *attr, int *fd) {
+  pid_t child_pid = spawn_child(command, type, attr, fd);
 
-  /* check if mypopen was previously run */
-  if (global_stream == NULL) {
-    errno = ECHILD;
-    return -1;
+  if (child_pid == -1) {
+    mypopen_stats_spawn_failed(errno);
+  } else {
+    mypopen_stats_spawned();
   }
 
-  /* check if we are closing the correct stream */
-  if (global_stream != stream) {
-    errno = EINVAL;
-    return -1;
-  }
+  return child_pid;
+}
 
-  /* close the stream */
-  if (fclose(stream) == EOF) {
-    pid = -1;
-    global_stream = NULL;
-    /* errno is set by fclose */
-    return -1;
-  }
+/**
+ * @brief initiate a pipe stream to or from a process created with options
+ *
+ * See struct mypopen_attr for the options. With MYPOPEN_SETPGRP the process
+ * group can be signalled with mypkill and is terminated as a whole if closing
+ * has to escalate. With MYPOPEN_SUBREAPER whatever is left of the process
+ * group is killed and reaped when the stream is closed, so no zombies pile up.
+ *
+ * @param command the command to be executed
+ * @param type the I/O mode (r/w)
+ * @param attr the options for the child process (may be NULL)
+ *
+ * @returns a file pointer or NULL in case of error
+ */
+FILE *mypopen_ex(const char *command, const char *type, const struct mypopen_attr *attr) {
+  struct cache_key key;
+  int fd;
 
-  /* wait for the child process to terminate */
-  while ((wait_pid = waitpid(pid, &status, 0)) != pid) {
-    if (wait_pid == -1) {
-      if (errno == EINTR) {
-        continue;
+  /* check if already open */
+  if (global_stream != NULL) {
+    errno = EAGAIN;
+    return NULL;
+  }
+
+  /* data for the standard input replaces the stream of "w" mode */
+  if (attr != NULL && attr->stdin_data != NULL && type != NULL && type[0] == 'w') {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  /* serve the output from the cache if enabled */
+  if ((fd = mypopen_cache_lookup(command, type, attr, &key)) != -1) {
+    global_cached = 1;
+  } else {
+    /* create the child process */
+    if ((pid = mypspawn(command, type, attr, &fd)) == -1) {
+      int saved_errno = errno;
+
+      free(key.data);
+      /* errno is set by mypspawn */
+      errno = saved_errno;
+      return NULL;
+    }
+    mypopen_stats_started();
+
+    /* let the output pass through the cache if enabled */
+    mypopen_cache_capture(&key, &fd);
+  }
+
+  if ((global_stream = fdopen(fd, type)) == NULL) {
+    int saved_errno = errno;
+
+    close(fd);
+    mypopen_cache_discard();
+    /* nobody is going to talk to the child, so it is ended and waited for */
+    if (pid != -1) {
+      kill(pid, SIGKILL);
+      while (waitpid(pid, NULL, 0) == -1 && errno == EINTR) {
       }
-      /* reached only in case of error */
-      pid = -1;
-      global_stream = NULL;
-      /* errno is set by waitpid */
+    }
+    reset_globals();
+    /* errno was set by fdopen */
+    errno = saved_errno;
+    return NULL;
+  }
+  /* give the stream a buffer kept from the previous one instead of a fresh malloc */
+  if ((global_buffer = mypopen_slab_alloc(STREAM_BUFFER_SIZE)) != NULL &&
+      setvbuf(global_stream, global_buffer, _IOFBF, STREAM_BUFFER_SIZE) != 0) {
+    mypopen_slab_free(global_buffer, STREAM_BUFFER_SIZE);
+    global_buffer = NULL;
+  }
+
+  global_flags = attr != NULL ? attr->flags : 0;
+  if (global_flags & MYPOPEN_SUBREAPER) {
+    global_flags |= MYPOPEN_SETPGRP;
+  }
+
+  return global_stream;
+}
+
+/**
+ * @brief send a signal to the process (group) behind a pipe stream
+ *
+ * @param stream the stream returned by mypopen
+ * @param signo the signal to be sent
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+int mypkill(FILE *stream, int signo) {
+  /* check if mypopen was previously run */
+  if (global_stream == NULL) {
+    errno = ECHILD;
+    return -1;
+  }
+
+  /* check if we are signalling the correct stream */
+  if (global_stream != stream) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* there is no process behind cached output, it behaves like one that has exited */
+  if (global_cached) {
+    return 0;
+  }
+
+  /* errno is set by kill */
+  return kill(signal_target(), signo);
+}
+
+/**
+ * @brief close the pipe stream after checking that it was opened by mypopen
+ *
+ * @param stream the stream to be closed
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int close_stream(FILE *stream) {
+  int result;
+
+  /* check if mypopen was previously run */
+  if (global_stream == NULL) {
+    errno = ECHILD;
+    return -1;
+  }
+
+  /* check if we are closing the correct stream */
+  if (global_stream != stream) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* close the stream, its buffer is not used any more even if that fails */
+  result = fclose(stream);
+  mypopen_slab_free(global_buffer, STREAM_BUFFER_SIZE);
+  global_buffer = NULL;
+  if (result == EOF) {
+    reset_globals();
+    /* errno is set by fclose */
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief close a stream replaying cached output
+ *
+ * @param status where to store the status (that of a process exiting with 0)
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int close_cached(FILE *stream, int *status) {
+  if (close_stream(stream) == -1) {
+    /* errno is set by close_stream */
+    return -1;
+  }
+
+  reset_globals();
+  *status = 0;
+
+  return 0;
+}
+
+/**
+ * @brief wait for a child process to terminate without reaping it
+ *
+ * The child stays a zombie, so its process id and process group cannot be
+ * taken by another process until reap_process has dealt with the group.
+ *
+ * @param child the process id of the child
+ * @param nohang return at once if the child has not terminated yet
+ *
+ * @returns 1 if the child has terminated, 0 if not or -1 in case of error
+ */
+static int wait_exited(pid_t child, int nohang) {
+  siginfo_t info;
+
+  for (;;) {
+    info.si_pid = 0;
+    if (waitid(P_PID, (id_t)child, &info, WEXITED | WNOWAIT | (nohang ? WNOHANG : 0)) == 0) {
+      return info.si_pid == child;
+    }
+    if (errno != EINTR) {
+      /* errno is set by waitid */
       return -1;
     }
   }
+}
+
+/**
+ * @brief reap a terminated child process and what is left of its process group
+ *
+ * The group is killed before the child is reaped: the zombie of the child
+ * still holds the id of the group, so the signal cannot reach an unrelated
+ * group that got the id meanwhile. Only descendants adopted as child
+ * subreaper can be reaped.
+ *
+ * @param child the process id of the child, which must have terminated
+ * @param status where to store the status returned by waitpid
+ * @param group the process group of the child or 0 if it had none
+ * @param terminate whether the rest of the process group shall be killed
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int reap_process(pid_t child, int *status, pid_t group, int terminate) {
+  pid_t wait_pid;
+
+  if (group > 0 && terminate) {
+    kill(-group, SIGKILL);
+  }
+
+  while ((wait_pid = waitpid(child, status, 0)) == -1 && errno == EINTR) {
+  }
+  if (wait_pid == -1) {
+    /* errno is set by waitpid */
+    return -1;
+  }
+
+  if (group > 0) {
+    while ((wait_pid = waitpid(-group, NULL, terminate ? 0 : WNOHANG)) > 0 ||
+           (wait_pid == -1 && errno == EINTR)) {
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief reap the terminated child process and its group and reset the global variables
+ *
+ * @param status where to store the status returned by waitpid
+ * @param group the process group of the child or 0 if it had none
+ * @param terminate whether the rest of the process group shall be killed
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int reap_child(int *status, pid_t group, int terminate) {
+  int result = wait_exited(pid, 0) == -1 ? -1 : reap_process(pid, status, group, terminate);
+  int saved_errno = errno;
 
   /* reset the global variables */
-  pid = -1;
-  global_stream = NULL;
+  reset_globals();
+  errno = saved_errno;
+
+  return result;
+}
+
+/**
+ * @brief get the milliseconds passed since a point in time
+ *
+ * @param start the point in time (CLOCK_MONOTONIC)
+ *
+ * @returns the milliseconds passed since start
+ */
+static long elapsed_ms(const struct timespec *start) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000L + (now.tv_nsec - start->tv_nsec) / 1000000L;
+}
+
+/**
+ * @brief wait for the child process to terminate for a limited time
+ *
+ * The child process is watched through a pidfd if the kernel supports it,
+ * otherwise waitid is polled with an increasing delay. The child is not
+ * reaped, which is left to reap_child. The global variables are reset in
+ * case of error.
+ *
+ * @param timeout_ms the time to wait in milliseconds or -1 to wait forever
+ *
+ * @returns 1 if the child terminated, 0 if the time ran out or -1 in case of error
+ */
+static int wait_child_timeout(int timeout_ms) {
+  struct timespec start;
+  long remaining, delay = 1;
+  int pidfd = -1;
+  int result;
+
+  if (timeout_ms < 0) {
+    if ((result = wait_exited(pid, 0)) == -1) {
+      int saved_errno = errno;
+
+      reset_globals();
+      errno = saved_errno;
+    }
+    return result;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+#ifdef SYS_pidfd_open
+  pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+#endif
+
+  for (;;) {
+    if ((result = wait_exited(pid, 1)) != 0) {
+      /* terminated or error, errno is set by waitid */
+      break;
+    }
+
+    if ((remaining = timeout_ms - elapsed_ms(&start)) <= 0) {
+      result = 0;
+      break;
+    }
+
+    if (pidfd != -1) {
+      /* the pidfd becomes readable once the child has terminated */
+      struct pollfd pfd = {pidfd, POLLIN, 0};
+
+      if (poll(&pfd, 1, (int)remaining) == -1 && errno != EINTR) {
+        /* errno is set by poll */
+        result = -1;
+        break;
+      }
+    } else {
+      struct timespec ts;
+
+      delay = delay < remaining ? delay : remaining;
+      ts.tv_sec = delay / 1000;
+      ts.tv_nsec = (delay % 1000) * 1000000L;
+      nanosleep(&ts, NULL);
+      delay = delay * 2 < MAX_POLL_DELAY_MS ? delay * 2 : MAX_POLL_DELAY_MS;
+    }
+  }
+
+  if (pidfd != -1) {
+    int saved_errno = errno;
+
+    close(pidfd);
+    errno = saved_errno;
+  }
+
+  if (result == -1) {
+    int saved_errno = errno;
+
+    reset_globals();
+    errno = saved_errno;
+  }
+
+  return result;
+}
+
+/**
+ * @brief flush the data buffered for the child with a deadline
+ *
+ * Writing to the pipe blocks until the child has read enough of it, so the
+ * data is only flushed once the pipe has room for it. If that does not
+ * happen in time, the data is discarded, so closing the stream does not
+ * block past the deadline.
+ *
+ * @param stream the stream opened with "w"
+ * @param timeout_ms the time to wait in milliseconds
+ *
+ * @returns the milliseconds left of timeout_ms
+ */
+static int flush_stream_timeout(FILE *stream, int timeout_ms) {
+  size_t pending = __fpending(stream);
+  int fd = fileno(stream);
+  struct timespec start;
+  long remaining, delay = 1;
+  int capacity;
+  int used;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (pending == 0 || (capacity = fcntl(fd, F_GETPIPE_SZ)) <= 0) {
+    return timeout_ms;
+  }
+  /* more than the pipe holds is written as soon as it is empty */
+  if (pending > (size_t)capacity) {
+    pending = (size_t)capacity;
+  }
+
+  while (ioctl(fd, FIONREAD, &used) == 0 && (size_t)(capacity - used) < pending) {
+    struct pollfd pfd = {fd, 0, 0};
+    struct timespec ts;
+
+    /* the write fails right away if the child has closed the pipe */
+    if (poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLERR) != 0) {
+      break;
+    }
+    if ((remaining = timeout_ms - elapsed_ms(&start)) <= 0) {
+      __fpurge(stream);
+      return 0;
+    }
+
+    delay = delay < remaining ? delay : remaining;
+    ts.tv_sec = delay / 1000;
+    ts.tv_nsec = (delay % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+    delay = delay * 2 < MAX_POLL_DELAY_MS ? delay * 2 : MAX_POLL_DELAY_MS;
+  }
+
+  remaining = timeout_ms - elapsed_ms(&start);
+  return remaining > 0 ? (int)remaining : 0;
+}
 
+/**
+ * @brief translate the status returned by waitpid to the result of mypclose
+ *
+ * @param status the status returned by waitpid
+ *
+ * @returns the exit status of the process or -1 in case of error
+ */
+static int exit_status(int status) {
   /* check if the child process terminated normally */
   if (WIFEXITED(status) != 0) {
     return WEXITSTATUS(status);
@@ -153,3 +1073,321 @@ int mypclose(FILE *stream) {
   errno = ECHILD;
   return -1;
 }
+
+/**
+ * @brief close a pipe stream to or from a process
+ *
+ * @param stream the stream to be closed
+ *
+ * @returns the exit status of the process or -1 in case of error
+ */
+int mypclose(FILE *stream) {
+  pid_t group = (global_flags & MYPOPEN_SETPGRP) ? pid : 0;
+  int subreaper = (global_flags & MYPOPEN_SUBREAPER) != 0;
+  int status;
+
+  if (global_cached && global_stream == stream) {
+    return close_cached(stream, &status) == -1 ? -1 : exit_status(status);
+  }
+
+  if (close_stream(stream) == -1) {
+    /* errno is set by close_stream */
+    return -1;
+  }
+
+  /* wait for the child process to terminate */
+  if (reap_child(&status, group, subreaper) == -1) {
+    /* errno is set by reap_child */
+    return -1;
+  }
+
+  mypopen_cache_commit(status);
+
+  return exit_status(status);
+}
+
+/**
+ * @brief close a pipe stream to or from a process with a deadline
+ *
+ * Once the child process did not terminate within timeout_ms, the signals
+ * of the escalation steps are sent one after another, each one followed by
+ * waiting for its grace period. After the last step the child is waited for
+ * without a deadline whatever its grace period, so the last signal should be
+ * one that cannot be ignored, like SIGKILL. If steps is NULL, SIGTERM is sent
+ * and SIGKILL follows after a second. The signals go to the whole process
+ * group if the child was created with MYPOPEN_SETPGRP, in which case
+ * whatever is left of the group after an escalation is killed. In "w" mode
+ * the deadline includes flushing the data buffered for the child; what the
+ * child does not take in time is discarded.
+ *
+ * @param stream the stream to be closed
+ * @param timeout_ms the time to wait before escalating or -1 to wait forever
+ * @param steps the signals to be sent and the time to wait after each of them
+ * @param nsteps the number of escalation steps
+ * @param wstatus where to store the status returned by waitpid (may be NULL)
+ *
+ * @returns the exit status of the process or -1 in case of error, errno is
+ *          set to ETIMEDOUT if the child had to be signalled
+ */
+int mypclose_timeout(FILE *stream, int timeout_ms, const struct mypclose_step *steps,
+                     size_t nsteps, int *wstatus) {
+  pid_t group = (global_flags & MYPOPEN_SETPGRP) ? pid : 0;
+  int subreaper = (global_flags & MYPOPEN_SUBREAPER) != 0;
+  int status;
+  int result;
+  size_t i;
+
+  if (steps == NULL) {
+    steps = default_steps;
+    nsteps = sizeof(default_steps) / sizeof(default_steps[0]);
+  }
+
+  if (global_cached && global_stream == stream) {
+    if (close_cached(stream, &status) == -1) {
+      /* errno is set by close_cached */
+      return -1;
+    }
+    if (wstatus != NULL) {
+      *wstatus = status;
+    }
+    return exit_status(status);
+  }
+
+  /* the deadline starts before the data buffered for the child is flushed */
+  if (timeout_ms >= 0 && global_stream != NULL && global_stream == stream &&
+      __fwriting(stream)) {
+    timeout_ms = flush_stream_timeout(stream, timeout_ms);
+  }
+
+  if (close_stream(stream) == -1) {
+    /* errno is set by close_stream */
+    return -1;
+  }
+
+  /* wait for the child process, escalating every time the deadline expires */
+  result = wait_child_timeout(timeout_ms);
+  for (i = 0; result == 0 && i < nsteps; ++i) {
+    kill(signal_target(), steps[i].signo);
+    result = wait_child_timeout(i + 1 < nsteps ? steps[i].grace_ms : -1);
+  }
+  if (result == 0) {
+    /* no escalation steps */
+    result = wait_child_timeout(-1);
+  }
+
+  if (result == -1) {
+    /* errno is set by wait_child_timeout */
+    return -1;
+  }
+  if (reap_child(&status, group, subreaper || i > 0) == -1) {
+    /* errno is set by reap_child */
+    return -1;
+  }
+
+  mypopen_cache_commit(status);
+
+  if (wstatus != NULL) {
+    *wstatus = status;
+  }
+
+  /* check if the child had to be signalled */
+  if (i > 0) {
+    if (steps != abort_steps) {
+      mypopen_stats_close_timeout();
+    }
+    errno = ETIMEDOUT;
+    return -1;
+  }
+
+  return exit_status(status);
+}
+
+/**
+ * @brief close a pipe stream to or from a process and terminate the process
+ *
+ * Data not yet written to the child is discarded and the child (or its
+ * whole process group with MYPOPEN_SETPGRP) is killed right away unless it
+ * has already terminated, so no time is spent on output nobody is going to
+ * read.
+ *
+ * @param stream the stream to be closed
+ * @param wstatus where to store the status returned by waitpid (may be NULL)
+ *
+ * @returns the exit status of the process or -1 in case of error, errno is
+ *          set to ECANCELED if the child had to be killed
+ */
+int mypclose_abort(FILE *stream, int *wstatus) {
+  int result;
+
+  /* discard buffered data instead of flushing it to the child */
+  if (global_stream != NULL && global_stream == stream) {
+    __fpurge(stream);
+  }
+
+  if ((result = mypclose_timeout(stream, 0, abort_steps, 1, wstatus)) == -1 && errno == ETIMEDOUT) {
+    errno = ECANCELED;
+  }
+
+  return result;
+}
+
+/**
+ * @brief create an anonymous file in memory for the output of a child process
+ *
+ * @returns the file descriptor or -1 in case of error
+ */
+int mypopen_create_capture_file(void) {
+  int fd = memfd_create("mypcapture", MFD_CLOEXEC);
+
+  if (fd == -1 && errno == ENOSYS) {
+    /* kernels before 3.17 */
+    fd = open(P_tmpdir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+  }
+
+  return fd;
+}
+
+/**
+ * @brief execute a command and capture its standard output in memory
+ *
+ * Instead of a pipe, the standard output of the child is an anonymous file
+ * in memory (a memfd). Once the child has terminated, the file is mapped
+ * read-only, so the output is never copied in user space and can be parsed
+ * in place. The standard input of the child is that of the caller unless
+ * the options carry stdin_data (see struct mypopen_attr).
+ *
+ * The output is available even if the command did not terminate normally
+ * and has to be released with mypcapture_free in any case.
+ *
+ * @param command the command to be executed
+ * @param attr the options for the child process (may be NULL)
+ * @param output where to store the output and the status of the child
+ *
+ * @returns the exit status of the process or -1 in case of error
+ */
+int mypcapture(const char *command, const struct mypopen_attr *attr,
+               struct mypcapture_output *output) {
+  struct program program = {-1, ""};
+  unsigned int flags = attr != NULL ? attr->flags : 0;
+  struct stat st;
+  pid_t child_pid;
+  int saved_errno;
+  int input;
+  int fd;
+
+  output->data = "";
+  output->size = 0;
+  output->wstatus = -1;
+
+  /* check the command input */
+  if (command == NULL) {
+    errno = EINVAL;
+    mypopen_stats_spawn_failed(errno);
+    return -1;
+  }
+
+  if (attr != NULL && attr->argv != NULL && mypopen_program_resolve(command, &program) == -1) {
+    /* errno is set by mypopen_program_resolve */
+    mypopen_stats_spawn_failed(errno);
+    return -1;
+  }
+
+  if (prepare_parent(&flags) == -1 || create_input_file(attr, &input) == -1) {
+    saved_errno = errno;
+    mypopen_program_release(&program);
+    /* errno was set by prepare_parent or create_input_file */
+    errno = saved_errno;
+    mypopen_stats_spawn_failed(errno);
+    return -1;
+  }
+
+  if ((fd = mypopen_create_capture_file()) == -1) {
+    saved_errno = errno;
+    if (input != -1) {
+      close(input);
+    }
+    mypopen_program_release(&program);
+    /* errno was set by mypopen_create_capture_file */
+    errno = saved_errno;
+    mypopen_stats_spawn_failed(errno);
+    return -1;
+  }
+
+  /* create a child process */
+  switch (child_pid = fork_child(attr)) {
+  /* error */
+  case -1:
+    saved_errno = errno;
+    close(fd);
+    if (input != -1) {
+      close(input);
+    }
+    mypopen_program_release(&program);
+    errno = saved_errno;
+    mypopen_stats_spawn_failed(errno);
+    return -1;
+  /* child */
+  case 0:
+    exec_child(command, attr, flags, fd, STDOUT_FILENO, input, &program);
+  /* parent */
+  default:
+    mypopen_stats_spawned();
+    mypopen_stats_started();
+    if (flags & MYPOPEN_SETPGRP) {
+      setpgid(child_pid, child_pid);
+    }
+    if (input != -1) {
+      close(input);
+    }
+    mypopen_program_release(&program);
+  }
+
+  /* wait for the child process to terminate */
+  if (wait_exited(child_pid, 0) == -1 ||
+      reap_process(child_pid, &output->wstatus, (flags & MYPOPEN_SETPGRP) ? child_pid : 0,
+                   (flags & MYPOPEN_SUBREAPER) != 0) == -1) {
+    saved_errno = errno;
+    mypopen_stats_released();
+    close(fd);
+    errno = saved_errno;
+    return -1;
+  }
+  mypopen_stats_released();
+
+  /* map what has been written, the mapping stays valid once the file is closed */
+  if (fstat(fd, &st) == -1) {
+    saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return -1;
+  }
+  if (st.st_size > 0) {
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (map == MAP_FAILED) {
+      saved_errno = errno;
+      close(fd);
+      errno = saved_errno;
+      return -1;
+    }
+    output->data = map;
+    output->size = (size_t)st.st_size;
+    mypopen_stats_collected(output->size);
+  }
+  close(fd);
+
+  return exit_status(output->wstatus);
+}
+
+/**
+ * @brief release the output captured by mypcapture
+ *
+ * @param output the output
+ */
+void mypcapture_free(struct mypcapture_output *output) {
+  if (output->size > 0) {
+    munmap((void *)output->data, output->size);
+  }
+  output->data = "";
+  output->size = 0;
+}
@@ -1,12 +1,246 @@
 #ifndef _MYPOPEN_H_
 #define _MYPOPEN_H_
 
+#include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 #include <errno.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* flags of struct mypopen_attr */
+#define MYPOPEN_SETPGRP 0x1    /* run the child in a process group of its own */
+#define MYPOPEN_SUBREAPER 0x2  /* adopt descendants of the child, end them on close */
+#define MYPOPEN_SETSCHED 0x4   /* set the scheduling policy of the child to sched_policy */
+#define MYPOPEN_SETNICE 0x8    /* set the nice value of the child to nice */
+#define MYPOPEN_SETIOPRIO 0x10 /* set the I/O priority of the child to ioprio_class/level */
+
+/* I/O scheduling classes of struct mypopen_attr (IOPRIO_CLASS_* of linux/ioprio.h) */
+#define MYPOPEN_IOPRIO_RT 1   /* real-time, needs privileges */
+#define MYPOPEN_IOPRIO_BE 2   /* best-effort, level 0 (highest) to 7 */
+#define MYPOPEN_IOPRIO_IDLE 3 /* only when no other process needs the disk */
+
+/* the number of errno values told apart by struct mypstats */
+#define MYPSTATS_ERRNOS 64
+
+/* flags of mypcache_enable */
+#define MYPCACHE_KEY_CWD 0x1 /* the working directory is part of the key */
+#define MYPCACHE_KEY_ENV 0x2 /* the environment is part of the key */
+
+/**
+ * a resource limit of a child process
+ */
+struct myplimit {
+  int resource;        /* the resource, e.g. RLIMIT_AS */
+  struct rlimit limit; /* the soft and hard limit */
+};
+
+/**
+ * options applied to the child process by mypopen_ex, mypspawn, mypcapture and mypbatch
+ *
+ * The options changing the child itself are applied in the child before the
+ * command is executed; if one of them cannot be set, the child exits with 1.
+ */
+struct mypopen_attr {
+  /*
+   * MYPOPEN_* flags. With MYPOPEN_SETPGRP the whole tree started by the shell
+   * can be signalled at once; note that a process group in the background
+   * gets SIGTTIN/SIGTTOU when accessing the terminal. MYPOPEN_SUBREAPER makes
+   * the caller the child subreaper (PR_SET_CHILD_SUBREAPER) for the rest of
+   * its life, so orphaned descendants of the child are reparented to it.
+   */
+  unsigned int flags;
+  const char *const *inputs; /* files the output depends on, part of the cache key */
+  size_t ninputs;            /* the number of inputs */
+  /*
+   * data given to the child as its standard input or NULL. The child reads
+   * it from a sealed file in memory (a memfd) at its own pace, the caller
+   * does not feed it. In "w" mode there is no pipe then and fd is set to -1.
+   */
+  const void *stdin_data;
+  size_t stdin_size; /* the size of stdin_data */
+  char *const *envp; /* the environment of the child (see mypenv_envp) or NULL for environ */
+  const char *cwd;   /* the working directory of the child or NULL to inherit it */
+  /*
+   * run command with these arguments (argv[0] included) instead of via the
+   * shell, or NULL. Without a slash command is searched in PATH, found
+   * programs are remembered as O_PATH descriptors (see
+   * mypopen_forget_programs) and a missing one fails with ENOENT instead of
+   * a child exiting with 127. A relative path is resolved after changing to
+   * cwd.
+   */
+  char *const *argv;
+  const void *cpus;   /* the CPUs the child may run on (a cpu_set_t) or NULL */
+  size_t cpus_size;   /* the size of cpus */
+  int sched_policy;   /* the policy with MYPOPEN_SETSCHED, e.g. SCHED_BATCH or SCHED_IDLE */
+  int sched_priority; /* the static priority for sched_policy, 0 unless real-time */
+  int nice;           /* the nice value with MYPOPEN_SETNICE, negative needs the privilege */
+  /*
+   * the cgroup v2 directory to create the child in or NULL. It must allow
+   * processes (have no controllers enabled for children); the descendants
+   * of the child stay in it, so their memory and CPU are limited and
+   * accounted together. Creating the child fails with the errno of the
+   * kernel if the directory cannot be opened or the child cannot be placed
+   * there.
+   */
+  const char *cgroup;
+  /*
+   * resource limits set in the child, e.g. RLIMIT_AS, RLIMIT_CPU or
+   * RLIMIT_NOFILE, so a runaway command fails on its own instead of slowing
+   * down everything else
+   */
+  const struct myplimit *limits;
+  size_t nlimits;   /* the number of limits */
+  int ioprio_class; /* the I/O class with MYPOPEN_SETIOPRIO (MYPOPEN_IOPRIO_*) */
+  int ioprio_level; /* the level within ioprio_class, 0 (highest) to 7 */
+};
+
+/**
+ * the statistics of the library, as taken by mypstats_snapshot
+ */
+struct mypstats {
+  uint64_t spawns;                        /* children created */
+  uint64_t spawn_failures;                /* attempts to create a child that failed */
+  uint64_t spawn_errors[MYPSTATS_ERRNOS]; /* the failures by errno, at 0 if errno is larger */
+  uint64_t active;                        /* children the library has yet to wait for */
+  uint64_t zombies;                       /* terminated children of mypopen streams not closed */
+  uint64_t bytes_collected;               /* output read by the library, not the caller */
+  uint64_t bytes_stdin;                   /* bytes given to children as stdin_data */
+  uint64_t close_timeouts;                /* children mypclose_timeout had to signal */
+};
+
+/**
+ * an environment for child processes whose variables are kept in one arena
+ */
+struct mypenv {
+  char *arena;          /* the variables (NAME=value), NUL-terminated one after another */
+  size_t arena_size;    /* the size of the arena */
+  size_t arena_used;    /* the bytes of the arena in use, including garbage */
+  size_t garbage;       /* the bytes of replaced and removed variables */
+  size_t *offsets;      /* the offsets of the variables in the arena */
+  size_t count;         /* the number of variables */
+  size_t capacity;      /* the number of offsets there is room for */
+  char **envp;          /* the array handed to execve */
+  size_t envp_capacity; /* the number of pointers there is room for in envp */
+  int dirty;            /* set if envp has to be rebuilt */
+};
+
+/**
+ * a command compiled once by myptemplate_compile for creating many children
+ */
+struct myptemplate {
+  char *arena;  /* the words of the template, NUL-terminated one after another */
+  char **argv;  /* the words, NULL where a placeholder is */
+  int *slots;   /* for each word the number of its placeholder or -1 */
+  size_t argc;  /* the number of words */
+  size_t nargs; /* the number of arguments needed (highest placeholder + 1) */
+};
+
+/**
+ * a reader yielding the lines read from a file descriptor without copying them
+ */
+struct mypline_reader {
+  int fd;         /* the file descriptor read from */
+  char *buffer;   /* the data read but not yet handed out completely */
+  size_t size;    /* the size of the buffer */
+  size_t start;   /* the start of the next line in the buffer */
+  size_t end;     /* the end of the data in the buffer */
+  size_t scanned; /* the bytes after start known to contain no newline */
+  int eof;        /* set once the end of the data has been read */
+};
+
+/**
+ * statistics of the data drained from a stream by mypdrain
+ */
+struct mypdrain_stats {
+  uint64_t bytes; /* the number of bytes read */
+  uint64_t lines; /* the number of newlines read */
+  uint64_t hash;  /* the XXH64 hash (seed 0) of the data */
+};
+
+/**
+ * the outcome of a command run by mypbatch
+ */
+struct mypbatch_result {
+  char *output;  /* the standard output of the command, NUL-terminated */
+  size_t length; /* the number of bytes in output */
+  int wstatus;   /* the status returned by waitpid or -1 if not started */
+  int error;     /* the errno of a failed start or read or 0 */
+};
+
+/**
+ * called by mypbatch once a command has completed
+ */
+typedef void (*mypbatch_callback)(size_t index, const struct mypbatch_result *result,
+                                  void *data);
+
+/**
+ * the output of a command captured by mypcapture
+ */
+struct mypcapture_output {
+  const char *data; /* the output, mapped read-only */
+  size_t size;      /* the size of the output */
+  int wstatus;      /* the status returned by waitpid or -1 */
+};
+
+/**
+ * a step of the signal escalation performed by mypclose_timeout
+ */
+struct mypclose_step {
+  int signo;    /* the signal sent to the child */
+  int grace_ms; /* time to wait for the child before the next step, the last waits forever */
+};
+
+void mypopen_attr_init(struct mypopen_attr *attr);
+
 FILE *mypopen(const char *command, const char *type);
+FILE *mypopen_ex(const char *command, const char *type, const struct mypopen_attr *attr);
+pid_t mypspawn(const char *command, const char *type, const struct mypopen_attr *attr, int *fd);
+int mypkill(FILE *stream, int signo);
 int mypclose(FILE *stream);
+int mypclose_timeout(FILE *stream, int timeout_ms, const struct mypclose_step *steps,
+                     size_t nsteps, int *wstatus);
+int mypclose_abort(FILE *stream, int *wstatus);
+int mypcapture(const char *command, const struct mypopen_attr *attr,
+               struct mypcapture_output *output);
+void mypcapture_free(struct mypcapture_output *output);
+
+int mypline_init(struct mypline_reader *reader, int fd, size_t size);
+ssize_t mypline_next(struct mypline_reader *reader, const char **line);
+void mypline_destroy(struct mypline_reader *reader);
+int mypdrain(FILE *stream, struct mypdrain_stats *stats);
+
+void mypopen_forget_programs(void);
+
+void mypstats_snapshot(struct mypstats *stats);
+
+int myptemplate_compile(struct myptemplate *tmpl, const char *pattern);
+pid_t myptemplate_spawn(const struct myptemplate *tmpl, const char *const *args, const char *type,
+                        const struct mypopen_attr *attr, int *fd);
+void myptemplate_destroy(struct myptemplate *tmpl);
+
+int mypenv_init(struct mypenv *env, char *const *base);
+int mypenv_set(struct mypenv *env, const char *name, const char *value);
+int mypenv_unset(struct mypenv *env, const char *name);
+const char *mypenv_get(const struct mypenv *env, const char *name);
+char *const *mypenv_envp(struct mypenv *env);
+void mypenv_destroy(struct mypenv *env);
+
+int mypcache_enable(size_t max_bytes, int ttl_ms, unsigned int flags);
+int mypcache_enable_dir(const char *path, size_t max_bytes, unsigned int flags);
+void mypcache_disable(void);
+
+int mypbatch(const char *const *commands, size_t count, unsigned int concurrency,
+             const struct mypopen_attr *attr, struct mypbatch_result *results,
+             mypbatch_callback callback, void *data);
+void mypbatch_free(struct mypbatch_result *results, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* _MYPOPEN_H_ */
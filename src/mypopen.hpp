@@ -0,0 +1,162 @@
+#ifndef _MYPOPEN_HPP_
+#define _MYPOPEN_HPP_
+
+#include "mypopen.h"
+
+/**
+ * C++ interface of mypopen (the namespace cannot be called mypopen, since
+ * that name is taken by the function)
+ */
+namespace mypp {
+
+/**
+ * @brief a child process started by mypopen together with its pipe stream
+ *
+ * The process is closed and reaped by wait() or at the latest by the
+ * destructor. Errors are reported through the return values and error(),
+ * never by exceptions, and everything is inlined into calls of the C API.
+ */
+class Process {
+public:
+  Process() noexcept = default;
+
+  /**
+   * @brief start a child process
+   *
+   * @param command the command to be executed
+   * @param type the I/O mode (r/w)
+   * @param attr the options for the child process (may be nullptr)
+   *
+   * @returns the process, which evaluates to false in case of error
+   */
+  static Process open(const char *command, const char *type,
+                      const mypopen_attr *attr = nullptr) noexcept {
+    Process process;
+
+    if ((process.stream_ = mypopen_ex(command, type, attr)) == nullptr) {
+      process.error_ = errno;
+    }
+    return process;
+  }
+
+  Process(Process &&other) noexcept
+      : stream_(other.stream_), result_(other.result_), wstatus_(other.wstatus_),
+        error_(other.error_) {
+    other.stream_ = nullptr;
+  }
+
+  Process &operator=(Process &&other) noexcept {
+    if (this != &other) {
+      wait();
+      stream_ = other.stream_;
+      result_ = other.result_;
+      wstatus_ = other.wstatus_;
+      error_ = other.error_;
+      other.stream_ = nullptr;
+    }
+    return *this;
+  }
+
+  Process(const Process &) = delete;
+  Process &operator=(const Process &) = delete;
+
+  ~Process() { wait(); }
+
+  /**
+   * @returns whether the process is running, i.e. has not been waited for yet
+   */
+  explicit operator bool() const noexcept { return stream_ != nullptr; }
+
+  /**
+   * @returns the pipe stream or nullptr if the process is not running
+   */
+  FILE *stream() const noexcept { return stream_; }
+
+  /**
+   * @brief close the pipe stream and wait for the child process
+   *
+   * @returns the exit status of the process or -1 in case of error
+   */
+  int wait() noexcept { return close(mypclose_timeout, -1, nullptr, 0); }
+
+  /**
+   * @brief close the pipe stream and wait for the child process with a deadline
+   *
+   * @see mypclose_timeout
+   *
+   * @returns the exit status of the process or -1 in case of error
+   */
+  int wait_for(int timeout_ms, const mypclose_step *steps = nullptr,
+               size_t nsteps = 0) noexcept {
+    return close(mypclose_timeout, timeout_ms, steps, nsteps);
+  }
+
+  /**
+   * @brief close the pipe stream and kill the child process
+   *
+   * @see mypclose_abort
+   *
+   * @returns the exit status of the process or -1 in case of error
+   */
+  int abort() noexcept {
+    if (stream_ != nullptr) {
+      result_ = mypclose_abort(stream_, &wstatus_);
+      finish();
+    }
+    return result_;
+  }
+
+  /**
+   * @brief send a signal to the child process (group)
+   *
+   * @returns 0 on success or -1 in case of error
+   */
+  int kill(int signo) noexcept {
+    if (mypkill(stream_, signo) == -1) {
+      error_ = errno;
+      return -1;
+    }
+    return 0;
+  }
+
+  /**
+   * @returns the result of the last wait, i.e. the exit status or -1
+   */
+  int result() const noexcept { return result_; }
+
+  /**
+   * @returns the status returned by waitpid for the child (see <sys/wait.h>)
+   */
+  int wstatus() const noexcept { return wstatus_; }
+
+  /**
+   * @returns the errno of the last failed operation or 0
+   */
+  int error() const noexcept { return error_; }
+
+private:
+  using close_function = int (*)(FILE *, int, const mypclose_step *, size_t, int *);
+
+  int close(close_function function, int timeout_ms, const mypclose_step *steps,
+            size_t nsteps) noexcept {
+    if (stream_ != nullptr) {
+      result_ = function(stream_, timeout_ms, steps, nsteps, &wstatus_);
+      finish();
+    }
+    return result_;
+  }
+
+  void finish() noexcept {
+    error_ = result_ == -1 ? errno : 0;
+    stream_ = nullptr;
+  }
+
+  FILE *stream_ = nullptr;
+  int result_ = -1;
+  int wstatus_ = 0;
+  int error_ = 0;
+};
+
+} // namespace mypp
+
+#endif /* _MYPOPEN_HPP_ */
@@ -0,0 +1,254 @@
+#include "mypopen_private.h"
+
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * the initial size of the buffer collecting the output of a command
+ */
+#define INITIAL_OUTPUT_SIZE 4096
+
+/**
+ * a command being run by mypbatch
+ */
+struct slot {
+  size_t index;                  /* the index of the command */
+  pid_t pid;                     /* the process id of the child */
+  int fd;                        /* the pipe from the child */
+  size_t capacity;               /* the size of result.output */
+  struct mypbatch_result result; /* the result collected so far */
+};
+
+/**
+ * @brief wait for a child, retrying if interrupted
+ *
+ * @returns the status returned by waitpid or -1 in case of error
+ */
+static int wait_child(pid_t child) {
+  int wstatus;
+  pid_t wait_pid;
+
+  while ((wait_pid = waitpid(child, &wstatus, 0)) == -1 && errno == EINTR) {
+  }
+  mypopen_stats_released();
+
+  return wait_pid == -1 ? -1 : wstatus;
+}
+
+/**
+ * @brief hand over a result to the caller
+ *
+ * The output is kept in the result array if there is one, otherwise it is
+ * freed once the callback has seen it.
+ */
+static void deliver(size_t index, struct mypbatch_result *result,
+                    struct mypbatch_result *results, mypbatch_callback callback, void *data) {
+  if (result->output == NULL && result->error == 0) {
+    /* the command did not produce any output */
+    if ((result->output = malloc(1)) == NULL) {
+      result->error = errno;
+    } else {
+      result->output[0] = '\0';
+    }
+  }
+
+  if (results != NULL) {
+    results[index] = *result;
+    result = &results[index];
+  }
+  if (callback != NULL) {
+    callback(index, result, data);
+  }
+  if (results == NULL) {
+    free(result->output);
+  }
+}
+
+/**
+ * @brief read what is available from the pipe of a slot
+ *
+ * @returns 1 if more data may follow or 0 at the end of the data
+ */
+static int collect(struct slot *slot) {
+  struct mypbatch_result *result = &slot->result;
+  char discard[INITIAL_OUTPUT_SIZE];
+  char *buffer = discard;
+  size_t size = sizeof(discard);
+  ssize_t n;
+
+  if (result->error == 0 && result->length + 1 >= slot->capacity) {
+    /* keep room for the terminating NUL */
+    size_t capacity = slot->capacity == 0 ? INITIAL_OUTPUT_SIZE : slot->capacity * 2;
+    char *output = realloc(result->output, capacity);
+
+    if (output == NULL) {
+      /* the output is discarded, but the child must not block on a full pipe */
+      result->error = errno;
+      free(result->output);
+      result->output = NULL;
+      result->length = 0;
+    } else {
+      result->output = output;
+      slot->capacity = capacity;
+    }
+  }
+  if (result->error == 0) {
+    buffer = result->output + result->length;
+    size = slot->capacity - result->length - 1;
+  }
+
+  while ((n = read(slot->fd, buffer, size)) == -1 && errno == EINTR) {
+  }
+  if (n == -1) {
+    if (result->error == 0) {
+      result->error = errno;
+      free(result->output);
+      result->output = NULL;
+      result->length = 0;
+    }
+    return 0;
+  }
+  mypopen_stats_collected((size_t)n);
+  if (result->error == 0) {
+    result->length += (size_t)n;
+    result->output[result->length] = '\0';
+  }
+
+  return n > 0;
+}
+
+/**
+ * @brief run commands with a bounded number of them running at the same time
+ *
+ * The commands are run like with mypspawn in "r" mode, their standard output
+ * is collected. Up to concurrency children are running at a time; as soon as
+ * one has completed, the next command is started. All pipes are served by a
+ * single poll loop on the calling thread, so no locking is involved.
+ *
+ * The results are stored in results in the order of the commands and/or
+ * passed to callback in the order the commands complete. Without a result
+ * array the output is freed after the callback has returned. A command that
+ * cannot be started is reported with a wstatus of -1 and its errno.
+ *
+ * @param commands the commands to be executed
+ * @param count the number of commands
+ * @param concurrency the maximum number of children running at the same time
+ * @param attr the options for the child processes (may be NULL)
+ * @param results an array of count results or NULL (free it with mypbatch_free)
+ * @param callback called for each completed command or NULL
+ * @param data passed to callback
+ *
+ * @returns 0 if all the commands have been run or -1 in case of error
+ */
+int mypbatch(const char *const *commands, size_t count, unsigned int concurrency,
+             const struct mypopen_attr *attr, struct mypbatch_result *results,
+             mypbatch_callback callback, void *data) {
+  struct slot *slots;
+  struct pollfd *fds;
+  size_t next = 0;
+  unsigned int running = 0;
+  unsigned int i;
+  int saved_errno;
+
+  if (commands == NULL || concurrency == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (results != NULL) {
+    memset(results, 0, count * sizeof(*results));
+  }
+
+  if ((slots = malloc(concurrency * sizeof(*slots))) == NULL) {
+    /* errno is set by malloc */
+    return -1;
+  }
+  if ((fds = malloc(concurrency * sizeof(*fds))) == NULL) {
+    /* errno is set by malloc */
+    free(slots);
+    return -1;
+  }
+
+  while (next < count || running > 0) {
+    /* fill the free slots */
+    while (next < count && running < concurrency) {
+      struct slot *slot = &slots[running];
+
+      memset(slot, 0, sizeof(*slot));
+      slot->index = next++;
+      if ((slot->pid = mypspawn(commands[slot->index], "r", attr, &slot->fd)) == -1) {
+        slot->result.error = errno;
+        slot->result.wstatus = -1;
+        deliver(slot->index, &slot->result, results, callback, data);
+        continue;
+      }
+      mypopen_stats_started();
+      ++running;
+    }
+    if (running == 0) {
+      continue;
+    }
+
+    for (i = 0; i < running; ++i) {
+      fds[i].fd = slots[i].fd;
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+    }
+    if (poll(fds, running, -1) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      goto error;
+    }
+
+    /* serve the ready pipes, backwards so completed slots can be filled from the end */
+    for (i = running; i-- > 0;) {
+      struct slot *slot = &slots[i];
+
+      if (fds[i].revents == 0 || collect(slot)) {
+        continue;
+      }
+
+      /* the child has closed its output */
+      close(slot->fd);
+      if ((slot->result.wstatus = wait_child(slot->pid)) == -1 && slot->result.error == 0) {
+        slot->result.error = errno;
+      }
+      deliver(slot->index, &slot->result, results, callback, data);
+
+      slots[i] = slots[--running];
+    }
+  }
+
+  free(fds);
+  free(slots);
+  return 0;
+
+error:
+  saved_errno = errno;
+  for (i = 0; i < running; ++i) {
+    close(slots[i].fd);
+    wait_child(slots[i].pid);
+    free(slots[i].result.output);
+  }
+  free(fds);
+  free(slots);
+  errno = saved_errno;
+  return -1;
+}
+
+/**
+ * @brief free the outputs stored in a result array by mypbatch
+ *
+ * @param results the result array
+ * @param count the number of results
+ */
+void mypbatch_free(struct mypbatch_result *results, size_t count) {
+  size_t i;
+
+  for (i = 0; i < count; ++i) {
+    free(results[i].output);
+    results[i].output = NULL;
+  }
+}
@@ -0,0 +1,1079 @@
+#define _GNU_SOURCE /* mkostemp, pipe2 */
+
+#include "mypopen_private.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+/**
+ * the number of buckets the hash table starts with
+ */
+#define INITIAL_BUCKETS 64
+
+/**
+ * the size of the blocks input files are hashed in
+ */
+#define HASH_BLOCK_SIZE (64 * 1024)
+
+/**
+ * the first bytes of a file in the cache directory
+ */
+#define FILE_MAGIC "MYPCACH1"
+
+/**
+ * the most read from the pipe of the child at once while recording its output
+ */
+#define PUMP_CHUNK_SIZE (64 * 1024)
+
+/**
+ * the environment of the calling process
+ */
+extern char **environ;
+
+/**
+ * the output of a command kept in memory
+ */
+struct entry {
+  struct entry *next;   /* the next entry in the same bucket */
+  struct entry *newer;  /* the entry used next after this one */
+  struct entry *older;  /* the entry used last before this one */
+  struct cache_key key; /* the key of the entry */
+  char *data;           /* the output of the command */
+  size_t size;          /* the size of the output */
+  long long expires_ms; /* when the entry expires (CLOCK_MONOTONIC) or -1 */
+};
+
+/**
+ * the header of a file in the cache directory, followed by the key and the output
+ */
+struct file_header {
+  char magic[8];     /* FILE_MAGIC */
+  uint64_t key_size; /* the size of the key */
+};
+
+/**
+ * the output of a child being recorded by a thread while it is passed on to the stream
+ */
+struct capture {
+  pthread_t thread;     /* the thread running pump */
+  int fd;               /* the pipe from the child */
+  int out;              /* the pipe to the stream */
+  int done;             /* an eventfd telling the thread that the child has been waited for */
+  struct cache_key key; /* the key the output will be stored under */
+  char *data;           /* the output read so far */
+  size_t size;          /* the size of the output read so far */
+  size_t capacity;      /* the size of data */
+  size_t limit;         /* the size of the largest output the cache can hold */
+  int eof;              /* set once the whole output has been read */
+  int dropped;          /* set if the output cannot be cached */
+};
+
+/**
+ * the global cache, empty and disabled until mypcache_enable or mypcache_enable_dir is called,
+ * used only by the thread calling mypopen (the thread of a capture sees only the capture)
+ */
+static struct {
+  int enabled;             /* whether outputs are kept in memory */
+  size_t max_bytes;        /* the memory the entries may use */
+  int ttl_ms;              /* the lifetime of an entry or -1 */
+  unsigned int flags;      /* MYPCACHE_* flags */
+  struct entry **buckets;  /* the hash table */
+  size_t nbuckets;         /* the number of buckets (a power of two) */
+  size_t count;            /* the number of entries */
+  size_t bytes;            /* the memory used by the entries */
+  struct entry *newest;    /* the entry used most recently */
+  struct entry *oldest;    /* the entry used least recently */
+  char *dir;               /* the cache directory or NULL */
+  size_t dir_max_bytes;    /* the disk space the files may use */
+  long long dir_bytes;     /* the disk space used by the files or -1 if unknown */
+  struct capture *capture; /* the output of the stream open or NULL */
+} cache = {.dir_bytes = -1};
+
+/**
+ * @returns the milliseconds on the monotonic clock
+ */
+static long long now_ms(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000LL + now.tv_nsec / 1000000L;
+}
+
+/**
+ * @brief append bytes to a key under construction
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int append(struct cache_key *key, size_t *capacity, const void *p, size_t size) {
+  if (key->size + size > *capacity) {
+    size_t new_capacity = *capacity == 0 ? 256 : *capacity;
+    char *data;
+
+    while (new_capacity < key->size + size) {
+      new_capacity *= 2;
+    }
+    if ((data = realloc(key->data, new_capacity)) == NULL) {
+      /* errno is set by realloc */
+      return -1;
+    }
+    key->data = data;
+    *capacity = new_capacity;
+  }
+  memcpy(key->data + key->size, p, size);
+  key->size += size;
+
+  return 0;
+}
+
+/**
+ * @brief hash the content of a file
+ *
+ * @param path the file
+ * @param hash where to store the hash
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int hash_file(const char *path, uint64_t *hash) {
+  struct xxh64_state state;
+  char *buffer;
+  ssize_t n;
+  int saved_errno;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) {
+    /* errno is set by open */
+    return -1;
+  }
+  if ((buffer = malloc(HASH_BLOCK_SIZE)) == NULL) {
+    saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return -1;
+  }
+
+  mypopen_xxh64_init(&state);
+  while ((n = read(fd, buffer, HASH_BLOCK_SIZE)) != 0) {
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    mypopen_xxh64_update(&state, (const unsigned char *)buffer, (size_t)n);
+  }
+  saved_errno = errno;
+  free(buffer);
+  close(fd);
+
+  if (n == -1) {
+    errno = saved_errno;
+    return -1;
+  }
+  *hash = mypopen_xxh64_digest(&state);
+  return 0;
+}
+
+/**
+ * @brief build the key for a command
+ *
+ * The key is the command followed by the working directory and a hash of
+ * the environment if the cache was enabled with the respective flags, and
+ * by the working directory and arguments given in attr, a hash of the data
+ * for the standard input and the path and a hash of the content of every
+ * input file in attr.
+ *
+ * @param command the command
+ * @param attr the options for the child process (may be NULL)
+ * @param key where to store the key
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int make_key(const char *command, const struct mypopen_attr *attr,
+                    struct cache_key *key) {
+  struct xxh64_state state;
+  size_t capacity = 0;
+  size_t i;
+
+  key->data = NULL;
+  key->size = 0;
+
+  if (append(key, &capacity, command, strlen(command) + 1) == -1) {
+    goto error;
+  }
+
+  if ((cache.flags & MYPCACHE_KEY_CWD) != 0) {
+    char cwd[PATH_MAX];
+
+    if (getcwd(cwd, sizeof(cwd)) == NULL || append(key, &capacity, cwd, strlen(cwd) + 1) == -1) {
+      goto error;
+    }
+  }
+
+  if ((cache.flags & MYPCACHE_KEY_ENV) != 0) {
+    uint64_t env_hash;
+    char *const *var;
+
+    mypopen_xxh64_init(&state);
+    for (var = attr != NULL && attr->envp != NULL ? attr->envp : environ; *var != NULL; ++var) {
+      mypopen_xxh64_update(&state, (const unsigned char *)*var, strlen(*var) + 1);
+    }
+    env_hash = mypopen_xxh64_digest(&state);
+    if (append(key, &capacity, &env_hash, sizeof(env_hash)) == -1) {
+      goto error;
+    }
+  }
+
+  /* the directory and the arguments given for the child are always part of the key */
+  if (attr != NULL && attr->cwd != NULL &&
+      append(key, &capacity, attr->cwd, strlen(attr->cwd) + 1) == -1) {
+    goto error;
+  }
+  for (i = 0; attr != NULL && attr->argv != NULL && attr->argv[i] != NULL; ++i) {
+    if (append(key, &capacity, attr->argv[i], strlen(attr->argv[i]) + 1) == -1) {
+      goto error;
+    }
+  }
+
+  if (attr != NULL && attr->stdin_data != NULL) {
+    uint64_t stdin_hash;
+
+    mypopen_xxh64_init(&state);
+    mypopen_xxh64_update(&state, attr->stdin_data, attr->stdin_size);
+    stdin_hash = mypopen_xxh64_digest(&state);
+    if (append(key, &capacity, &stdin_hash, sizeof(stdin_hash)) == -1) {
+      goto error;
+    }
+  }
+
+  for (i = 0; attr != NULL && i < attr->ninputs; ++i) {
+    uint64_t file_hash;
+
+    if (hash_file(attr->inputs[i], &file_hash) == -1 ||
+        append(key, &capacity, attr->inputs[i], strlen(attr->inputs[i]) + 1) == -1 ||
+        append(key, &capacity, &file_hash, sizeof(file_hash)) == -1) {
+      goto error;
+    }
+  }
+
+  mypopen_xxh64_init(&state);
+  mypopen_xxh64_update(&state, (const unsigned char *)key->data, key->size);
+  key->hash = mypopen_xxh64_digest(&state);
+  return 0;
+
+error:
+  free(key->data);
+  key->data = NULL;
+  return -1;
+}
+
+/**
+ * @returns whether two keys are equal
+ */
+static int same_key(const struct cache_key *a, const struct cache_key *b) {
+  return a->hash == b->hash && a->size == b->size && memcmp(a->data, b->data, a->size) == 0;
+}
+
+/**
+ * @brief free an entry
+ */
+static void free_entry(struct entry *entry) {
+  free(entry->key.data);
+  free(entry->data);
+  free(entry);
+}
+
+/**
+ * @returns the memory accounted for an entry
+ */
+static size_t entry_bytes(const struct entry *entry) {
+  return sizeof(*entry) + entry->key.size + entry->size;
+}
+
+/**
+ * @brief remove an entry from the recently used list
+ */
+static void unlink_lru(struct entry *entry) {
+  *(entry->newer != NULL ? &entry->newer->older : &cache.newest) = entry->older;
+  *(entry->older != NULL ? &entry->older->newer : &cache.oldest) = entry->newer;
+}
+
+/**
+ * @brief make an entry the most recently used one
+ */
+static void push_lru(struct entry *entry) {
+  entry->newer = NULL;
+  entry->older = cache.newest;
+  *(cache.newest != NULL ? &cache.newest->newer : &cache.oldest) = entry;
+  cache.newest = entry;
+}
+
+/**
+ * @brief remove an entry from the cache
+ */
+static void remove_entry(struct entry *entry) {
+  struct entry **link = &cache.buckets[entry->key.hash & (cache.nbuckets - 1)];
+
+  while (*link != entry) {
+    link = &(*link)->next;
+  }
+  *link = entry->next;
+  unlink_lru(entry);
+  cache.bytes -= entry_bytes(entry);
+  --cache.count;
+  free_entry(entry);
+}
+
+/**
+ * @brief remove the least recently used entries until the memory fits a limit
+ */
+static void evict(size_t limit) {
+  while (cache.bytes > limit && cache.oldest != NULL) {
+    remove_entry(cache.oldest);
+  }
+}
+
+/**
+ * @brief find the entry for a key, dropping it if it has expired
+ *
+ * @returns the entry or NULL if there is none
+ */
+static struct entry *find(const struct cache_key *key) {
+  struct entry *entry;
+
+  if (cache.buckets == NULL) {
+    return NULL;
+  }
+
+  for (entry = cache.buckets[key->hash & (cache.nbuckets - 1)]; entry != NULL;
+       entry = entry->next) {
+    if (same_key(&entry->key, key)) {
+      if (entry->expires_ms != -1 && now_ms() >= entry->expires_ms) {
+        remove_entry(entry);
+        return NULL;
+      }
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief double the number of buckets
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int grow(void) {
+  size_t nbuckets = cache.nbuckets == 0 ? INITIAL_BUCKETS : cache.nbuckets * 2;
+  struct entry **buckets = calloc(nbuckets, sizeof(*buckets));
+  size_t i;
+
+  if (buckets == NULL) {
+    /* errno is set by calloc */
+    return -1;
+  }
+
+  for (i = 0; i < cache.nbuckets; ++i) {
+    struct entry *entry, *next;
+
+    for (entry = cache.buckets[i]; entry != NULL; entry = next) {
+      next = entry->next;
+      entry->next = buckets[entry->key.hash & (nbuckets - 1)];
+      buckets[entry->key.hash & (nbuckets - 1)] = entry;
+    }
+  }
+  free(cache.buckets);
+  cache.buckets = buckets;
+  cache.nbuckets = nbuckets;
+
+  return 0;
+}
+
+/**
+ * @brief keep the output recorded by a capture in memory, the capture is emptied
+ */
+static void insert(struct capture *capture) {
+  struct entry *entry, *old;
+
+  if (cache.count >= cache.nbuckets && grow() == -1) {
+    return;
+  }
+  if ((entry = malloc(sizeof(*entry))) == NULL) {
+    return;
+  }
+
+  entry->key = capture->key;
+  entry->data = capture->data;
+  entry->size = capture->size;
+  entry->expires_ms = cache.ttl_ms < 0 ? -1 : now_ms() + cache.ttl_ms;
+  capture->key.data = capture->data = NULL;
+
+  if (entry_bytes(entry) > cache.max_bytes) {
+    free_entry(entry);
+    return;
+  }
+  if ((old = find(&entry->key)) != NULL) {
+    remove_entry(old);
+  }
+
+  entry->next = cache.buckets[entry->key.hash & (cache.nbuckets - 1)];
+  cache.buckets[entry->key.hash & (cache.nbuckets - 1)] = entry;
+  push_lru(entry);
+  cache.bytes += entry_bytes(entry);
+  ++cache.count;
+
+  evict(cache.max_bytes);
+}
+
+/**
+ * @brief get the path of the file for a key in the cache directory
+ *
+ * @returns 0 on success or -1 if the path is too long
+ */
+static int file_path(char *path, size_t size, uint64_t hash) {
+  if ((size_t)snprintf(path, size, "%s/%016" PRIx64, cache.dir, hash) >= size) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * a file in the cache directory considered for eviction
+ */
+struct file_info {
+  char name[17];        /* the name of the file */
+  struct timespec used; /* when the file was used last (its mtime) */
+  off_t size;           /* the size of the file */
+};
+
+static int compare_used(const void *a, const void *b) {
+  const struct timespec *x = &((const struct file_info *)a)->used;
+  const struct timespec *y = &((const struct file_info *)b)->used;
+
+  if (x->tv_sec != y->tv_sec) {
+    return x->tv_sec < y->tv_sec ? -1 : 1;
+  }
+  return x->tv_nsec < y->tv_nsec ? -1 : x->tv_nsec > y->tv_nsec;
+}
+
+/**
+ * @brief remove the least recently used files until the cache directory fits its limit
+ *
+ * The files are touched whenever they are used, so their mtime orders them.
+ */
+static void evict_files(void) {
+  struct file_info *files = NULL;
+  size_t count = 0, capacity = 0, i;
+  struct dirent *dirent;
+  long long bytes = 0;
+  DIR *dir;
+  int dfd;
+
+  if ((dir = opendir(cache.dir)) == NULL) {
+    return;
+  }
+  dfd = dirfd(dir);
+
+  while ((dirent = readdir(dir)) != NULL) {
+    struct stat st;
+
+    /* only the files named by a hash, not the ones still being written */
+    if (strlen(dirent->d_name) != 16 || strspn(dirent->d_name, "0123456789abcdef") != 16 ||
+        fstatat(dfd, dirent->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    if (count == capacity) {
+      struct file_info *more;
+
+      capacity = capacity == 0 ? 256 : capacity * 2;
+      if ((more = realloc(files, capacity * sizeof(*files))) == NULL) {
+        break;
+      }
+      files = more;
+    }
+    memcpy(files[count].name, dirent->d_name, sizeof(files[count].name));
+    files[count].used = st.st_mtim;
+    files[count].size = st.st_size;
+    bytes += st.st_size;
+    ++count;
+  }
+
+  if (count > 0) {
+    qsort(files, count, sizeof(*files), compare_used);
+  }
+  for (i = 0; i < count && bytes > (long long)cache.dir_max_bytes; ++i) {
+    if (unlinkat(dfd, files[i].name, 0) == 0) {
+      bytes -= files[i].size;
+    }
+  }
+
+  closedir(dir);
+  free(files);
+  cache.dir_bytes = bytes;
+}
+
+/**
+ * @brief write the output recorded by a capture to the cache directory
+ *
+ * The file is written under a temporary name and renamed, so other
+ * processes sharing the directory never see a partial file.
+ */
+static void write_file(const struct capture *capture) {
+  struct file_header header;
+  char path[PATH_MAX], temp[PATH_MAX];
+  struct iovec iov[3];
+  size_t total;
+  ssize_t n;
+  int fd;
+
+  if (file_path(path, sizeof(path), capture->key.hash) == -1 ||
+      (size_t)snprintf(temp, sizeof(temp), "%s/tmp.XXXXXX", cache.dir) >= sizeof(temp) ||
+      (fd = mkostemp(temp, O_CLOEXEC)) == -1) {
+    return;
+  }
+
+  memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+  header.key_size = capture->key.size;
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = capture->key.data;
+  iov[1].iov_len = capture->key.size;
+  iov[2].iov_base = capture->data;
+  iov[2].iov_len = capture->size;
+  total = sizeof(header) + capture->key.size + capture->size;
+
+  /* a regular file takes all of it unless the disk is full */
+  while ((n = writev(fd, iov, 3)) == -1 && errno == EINTR) {
+  }
+  if (close(fd) == -1 || n != (ssize_t)total || rename(temp, path) == -1) {
+    unlink(temp);
+    return;
+  }
+
+  if (cache.dir_bytes == -1 ||
+      (cache.dir_bytes += (long long)total) > (long long)cache.dir_max_bytes) {
+    evict_files();
+  }
+}
+
+/**
+ * @brief open the file for a key from the cache directory
+ *
+ * @param key the key
+ *
+ * @returns the file descriptor, positioned at the output, or -1 if there is no file for the key
+ */
+static int open_file(const struct cache_key *key) {
+  static const struct timespec touch[2] = {{0, UTIME_OMIT}, {0, UTIME_NOW}};
+  struct file_header header;
+  char path[PATH_MAX];
+  char *stored;
+  int same;
+  int fd;
+
+  if (file_path(path, sizeof(path), key->hash) == -1 ||
+      (fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) {
+    return -1;
+  }
+  if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+      memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.key_size != key->size || (stored = malloc(key->size)) == NULL) {
+    close(fd);
+    return -1;
+  }
+
+  /* the hash might collide, so the whole key is compared */
+  same = pread(fd, stored, key->size, sizeof(header)) == (ssize_t)key->size &&
+         memcmp(stored, key->data, key->size) == 0;
+  free(stored);
+  if (!same || lseek(fd, (off_t)(sizeof(header) + key->size), SEEK_SET) == -1) {
+    close(fd);
+    return -1;
+  }
+
+  /* mark the file as used for the eviction */
+  futimens(fd, touch);
+
+  return fd;
+}
+
+/**
+ * @brief write a whole buffer to a file descriptor
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int write_all(int fd, const char *p, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      /* errno is set by write */
+      return -1;
+    }
+    p += n;
+    size -= (size_t)n;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief copy an entry to an anonymous file in memory to be read like the pipe of a child
+ *
+ * @returns the file descriptor, positioned at the start, or -1 in case of error
+ */
+static int open_entry(const struct entry *entry) {
+  int fd;
+
+  if ((fd = mypopen_create_capture_file()) == -1) {
+    return -1;
+  }
+  if (write_all(fd, entry->data, entry->size) == -1 || lseek(fd, 0, SEEK_SET) == -1) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/**
+ * @brief free what a capture has recorded
+ */
+static void free_capture(struct capture *capture) {
+  free(capture->key.data);
+  free(capture->data);
+  capture->key.data = capture->data = NULL;
+}
+
+/**
+ * @brief give up recording the output of a capture
+ */
+static void drop(struct capture *capture) {
+  free(capture->data);
+  capture->data = NULL;
+  capture->size = capture->capacity = 0;
+  capture->dropped = 1;
+}
+
+/**
+ * @brief make room for the next read in the output recorded by a capture
+ *
+ * @returns where to read to or NULL if the output is not recorded
+ */
+static char *reserve(struct capture *capture) {
+  if (!capture->dropped && capture->size + PUMP_CHUNK_SIZE > capture->capacity) {
+    size_t capacity = capture->capacity == 0 ? PUMP_CHUNK_SIZE : capture->capacity;
+    char *data;
+
+    while (capacity < capture->size + PUMP_CHUNK_SIZE) {
+      capacity *= 2;
+    }
+    if ((data = realloc(capture->data, capacity)) == NULL) {
+      drop(capture);
+    } else {
+      capture->data = data;
+      capture->capacity = capacity;
+    }
+  }
+
+  return capture->dropped ? NULL : capture->data + capture->size;
+}
+
+/**
+ * @brief pass the output of a child on to the stream and record it, run by a thread of its own
+ *
+ * Recording stops as soon as the stream is closed, when the pipe to it
+ * reports an error: the pipe from the child is closed as well, so the child
+ * gets SIGPIPE like without the cache and its output is not stored. Once the
+ * child has been waited for, only what is left in the pipe is taken, as
+ * processes the child left behind may keep it open.
+ *
+ * @param arg the capture
+ *
+ * @returns NULL
+ */
+static void *pump(void *arg) {
+  struct capture *capture = arg;
+  struct pollfd pfd[3] = {
+      {capture->fd, POLLIN, 0}, {capture->done, POLLIN, 0}, {capture->out, 0, 0}};
+  char scratch[PUMP_CHUNK_SIZE];
+  int finishing = 0;
+
+  for (;;) {
+    char *buffer;
+    ssize_t n;
+
+    if (!finishing) {
+      /* all signals are blocked in this thread, so poll is not interrupted */
+      if (poll(pfd, 3, -1) == -1) {
+        drop(capture);
+        break;
+      }
+      if (pfd[2].revents != 0) {
+        /* POLLERR, the stream has been closed */
+        drop(capture);
+        break;
+      }
+      if (pfd[1].revents != 0) {
+        if (fcntl(capture->fd, F_SETFL, O_NONBLOCK) == -1) {
+          drop(capture);
+          break;
+        }
+        finishing = 1;
+      }
+    }
+
+    buffer = reserve(capture);
+    if ((n = read(capture->fd, buffer != NULL ? buffer : scratch, PUMP_CHUNK_SIZE)) == 0) {
+      capture->eof = 1;
+      break;
+    }
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      /* nothing left in the pipe while others still have it open */
+      drop(capture);
+      break;
+    }
+
+    if (write_all(capture->out, buffer != NULL ? buffer : scratch, (size_t)n) == -1) {
+      /* EPIPE, the stream has been closed */
+      drop(capture);
+      break;
+    }
+    if (buffer != NULL && (capture->size += (size_t)n) > capture->limit) {
+      /* too large to be cached anyway, but still passed on */
+      drop(capture);
+    }
+  }
+
+  close(capture->out);
+  capture->out = -1;
+  close(capture->fd);
+  capture->fd = -1;
+
+  return NULL;
+}
+
+/**
+ * @brief stop recording the output of the stream open and store it if possible
+ *
+ * @param store whether the output may be stored
+ * @param status the status returned by waitpid for the command if store is set
+ */
+static void end_capture(int store, int status) {
+  struct capture *capture = cache.capture;
+  int saved_errno = errno;
+  uint64_t one = 1;
+
+  if (capture == NULL) {
+    return;
+  }
+  cache.capture = NULL;
+
+  /* the eventfd is large enough for the counter to never block */
+  while (write(capture->done, &one, sizeof(one)) == -1 && errno == EINTR) {
+  }
+  pthread_join(capture->thread, NULL);
+  close(capture->done);
+
+  if (store && capture->eof && !capture->dropped && WIFEXITED(status) &&
+      WEXITSTATUS(status) == 0) {
+    if (cache.dir != NULL && capture->size <= cache.dir_max_bytes) {
+      write_file(capture);
+    }
+    if (cache.enabled) {
+      insert(capture);
+    }
+  }
+  free_capture(capture);
+  free(capture);
+
+  errno = saved_errno;
+}
+
+/**
+ * @returns the size of the largest output any of the enabled caches can hold
+ */
+static size_t capture_limit(void) {
+  size_t limit = cache.enabled ? cache.max_bytes : 0;
+
+  if (cache.dir != NULL && cache.dir_max_bytes > limit) {
+    limit = cache.dir_max_bytes;
+  }
+  return limit;
+}
+
+/**
+ * @returns whether a command opened with a type is served by the cache
+ */
+static int cacheable(const char *command, const char *type) {
+  return (cache.enabled || cache.dir != NULL) && command != NULL && type != NULL &&
+         strcmp(type, "r") == 0;
+}
+
+/**
+ * @brief open the cached output of a command
+ *
+ * The memory is looked at first, then the cache directory. If the output is
+ * not cached, the key is handed back for mypopen_cache_capture to record the output
+ * under, so it is built once per command.
+ *
+ * @param command the command
+ * @param type the I/O mode, only "r" is cached
+ * @param attr the options for the child process (may be NULL)
+ * @param key where to store the key if the output is not cached, its data is NULL if the
+ *            output is not going to be cached either and must be freed otherwise
+ *
+ * @returns a file descriptor to read the output from or -1 if the output is not cached
+ *          (errno is kept)
+ */
+int mypopen_cache_lookup(const char *command, const char *type,
+                         const struct mypopen_attr *attr, struct cache_key *key) {
+  int saved_errno = errno;
+  struct entry *entry = NULL;
+  int fd = -1;
+
+  key->data = NULL;
+
+  /* the output of a stream whose close failed is not going to be stored anymore */
+  end_capture(0, 0);
+
+  if (!cacheable(command, type) || make_key(command, attr, key) == -1) {
+    errno = saved_errno;
+    return -1;
+  }
+
+  if (cache.enabled && (entry = find(key)) != NULL) {
+    if ((fd = open_entry(entry)) != -1) {
+      unlink_lru(entry);
+      push_lru(entry);
+    }
+  } else if (cache.dir != NULL) {
+    fd = open_file(key);
+  }
+  if (fd != -1) {
+    free(key->data);
+    key->data = NULL;
+  }
+
+  errno = saved_errno;
+  return fd;
+}
+
+/**
+ * @brief record the output of a child for the cache while the stream reads it
+ *
+ * The pipe from the child is read by a thread, which passes the output on
+ * to a pipe of its own, so the stream still has a file descriptor that can
+ * be polled or read directly.
+ *
+ * @param key the key returned by mypopen_cache_lookup, which is taken over
+ * @param fd the pipe from the child, replaced by the pipe to read the output from
+ *
+ * @returns 0 if the output is recorded or -1 if it is not going to be cached (errno is kept)
+ */
+int mypopen_cache_capture(struct cache_key *key, int *fd) {
+  int saved_errno = errno;
+  struct capture *capture;
+  sigset_t all, old;
+  int pipe_ends[2];
+  int error;
+
+  if (key->data == NULL) {
+    return -1;
+  }
+  if ((capture = calloc(1, sizeof(*capture))) == NULL) {
+    free(key->data);
+    key->data = NULL;
+    errno = saved_errno;
+    return -1;
+  }
+
+  capture->fd = *fd;
+  capture->limit = capture_limit();
+  capture->key = *key;
+  key->data = NULL;
+  if (pipe2(pipe_ends, O_CLOEXEC) == -1) {
+    free_capture(capture);
+    free(capture);
+    errno = saved_errno;
+    return -1;
+  }
+  if ((capture->done = eventfd(0, EFD_CLOEXEC)) == -1) {
+    close(pipe_ends[0]);
+    close(pipe_ends[1]);
+    free_capture(capture);
+    free(capture);
+    errno = saved_errno;
+    return -1;
+  }
+  capture->out = pipe_ends[1];
+
+  /* signals meant for the process are left to its other threads */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  error = pthread_create(&capture->thread, NULL, pump, capture);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (error != 0) {
+    close(capture->done);
+    close(pipe_ends[0]);
+    close(pipe_ends[1]);
+    free_capture(capture);
+    free(capture);
+    errno = saved_errno;
+    return -1;
+  }
+
+  cache.capture = capture;
+  *fd = pipe_ends[0];
+  errno = saved_errno;
+  return 0;
+}
+
+/**
+ * @brief store the output recorded for the stream closed
+ *
+ * The output is stored only if it has been read up to its end and the
+ * command exited with status 0.
+ *
+ * @param status the status returned by waitpid for the command
+ */
+void mypopen_cache_commit(int status) { end_capture(1, status); }
+
+/**
+ * @brief stop recording the output for a stream that is not going to be used
+ */
+void mypopen_cache_discard(void) { end_capture(0, 0); }
+
+/**
+ * @brief set the flags selecting what is part of the key
+ *
+ * The entries in memory are dropped if the flags change, as their keys
+ * would not match anymore.
+ */
+static void set_flags(unsigned int flags) {
+  if (flags != cache.flags) {
+    evict(0);
+  }
+  cache.flags = flags;
+}
+
+/**
+ * @brief enable the cache for the output of commands run by mypopen
+ *
+ * Once enabled, mypopen and mypopen_ex keep the output of commands opened
+ * with "r" that exit with status 0. The output is passed on to the stream by
+ * a thread; if the stream is closed before the end of the output, nothing is
+ * stored and the child gets SIGPIPE as it would without the cache. The next
+ * time the same command is opened, a stream reading the output from a file
+ * in memory is returned instead of creating a process; mypclose then returns
+ * 0 without waiting for anything and mypkill does not signal anything.
+ * Either way the stream has a file descriptor like any other.
+ *
+ * The key of an entry is the command, extended by the working directory
+ * with MYPCACHE_KEY_CWD, by the environment with MYPCACHE_KEY_ENV and by
+ * the content of the input files declared in the options passed to
+ * mypopen_ex. The least recently used entries are evicted when the memory
+ * they use exceeds max_bytes. Calling the function again changes the limits.
+ *
+ * Like the stream of mypopen, the cache is global and not locked: mypopen,
+ * mypopen_ex, mypclose and the mypcache_* functions must not be called by
+ * several threads at the same time.
+ *
+ * @param max_bytes the memory the cached outputs may use
+ * @param ttl_ms the time an entry is valid in milliseconds or -1 for forever
+ * @param flags MYPCACHE_* flags, shared with the cache directory
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+int mypcache_enable(size_t max_bytes, int ttl_ms, unsigned int flags) {
+  if (max_bytes == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  set_flags(flags);
+  cache.enabled = 1;
+  cache.max_bytes = max_bytes;
+  cache.ttl_ms = ttl_ms < 0 ? -1 : ttl_ms;
+  evict(cache.max_bytes);
+
+  return 0;
+}
+
+/**
+ * @brief keep the output of commands run by mypopen in a directory as well
+ *
+ * The directory outlives the process and can be shared by several of them.
+ * Each output is stored in a file named after the hash of its key (see
+ * mypcache_enable), together with the key itself. When it is used again,
+ * the stream reads the output from that file, so a hit costs a read of the
+ * file rather than a process. Files do not expire; once they take up more
+ * than max_bytes, the least recently used ones are removed.
+ *
+ * The directory is consulted after the memory, which does not have to be
+ * enabled for it to be used.
+ *
+ * @param path the directory, which is created if it does not exist
+ * @param max_bytes the disk space the files may use
+ * @param flags MYPCACHE_* flags, shared with the memory
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+int mypcache_enable_dir(const char *path, size_t max_bytes, unsigned int flags) {
+  char *dir;
+
+  if (path == NULL || max_bytes == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (mkdir(path, 0700) == -1 && errno != EEXIST) {
+    /* errno is set by mkdir */
+    return -1;
+  }
+  if ((dir = strdup(path)) == NULL) {
+    /* errno is set by strdup */
+    return -1;
+  }
+
+  set_flags(flags);
+  free(cache.dir);
+  cache.dir = dir;
+  cache.dir_max_bytes = max_bytes;
+  cache.dir_bytes = -1;
+
+  return 0;
+}
+
+/**
+ * @brief disable the cache and drop the entries kept in memory
+ *
+ * The cache directory is left as it is. Streams opened from an entry can
+ * still be read until they are closed.
+ */
+void mypcache_disable(void) {
+  evict(0);
+  free(cache.buckets);
+  cache.buckets = NULL;
+  cache.nbuckets = 0;
+  cache.enabled = 0;
+  free(cache.dir);
+  cache.dir = NULL;
+}
@@ -0,0 +1,396 @@
+#ifndef _MYPOPEN_CORO_HPP_
+#define _MYPOPEN_CORO_HPP_
+
+#include "mypopen.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+namespace mypp {
+
+/**
+ * @brief an operation waiting for a file descriptor to become ready
+ *
+ * attempt is called whenever the file descriptor is reported ready and
+ * returns true once the operation is complete.
+ */
+struct pending_op {
+  std::coroutine_handle<> handle;
+  bool (*attempt)(pending_op *);
+  int fd;
+  std::uint32_t events;
+};
+
+/**
+ * @brief an epoll event loop resuming coroutines waiting for child I/O and exit
+ *
+ * All processes and coroutines driven by a reactor have to live on the
+ * thread calling run().
+ */
+class reactor {
+public:
+  reactor() noexcept : epfd_(epoll_create1(EPOLL_CLOEXEC)) {}
+
+  reactor(const reactor &) = delete;
+  reactor &operator=(const reactor &) = delete;
+
+  ~reactor() {
+    if (epfd_ != -1) {
+      ::close(epfd_);
+    }
+  }
+
+  /**
+   * @returns whether the epoll instance could be created
+   */
+  explicit operator bool() const noexcept { return epfd_ != -1; }
+
+  /**
+   * @brief resume waiting coroutines until no operation is pending anymore
+   *
+   * @returns 0 on success or -1 in case of error
+   */
+  int run() noexcept {
+    struct epoll_event events[64];
+
+    while (pending_ > 0) {
+      int n = epoll_wait(epfd_, events, sizeof(events) / sizeof(events[0]), -1);
+
+      if (n == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return -1;
+      }
+      for (int i = 0; i < n; ++i) {
+        pending_op *op = static_cast<pending_op *>(events[i].data.ptr);
+
+        if (op->attempt(op)) {
+          epoll_ctl(epfd_, EPOLL_CTL_DEL, op->fd, nullptr);
+          --pending_;
+          op->handle.resume();
+        }
+      }
+    }
+    return 0;
+  }
+
+  /**
+   * @brief suspend an operation until its file descriptor is ready
+   *
+   * @returns false if the file descriptor cannot be watched (errno is set)
+   */
+  bool wait(pending_op *op) noexcept {
+    struct epoll_event event;
+
+    event.events = op->events;
+    event.data.ptr = op;
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, op->fd, &event) == -1) {
+      return false;
+    }
+    ++pending_;
+    return true;
+  }
+
+private:
+  int epfd_;
+  std::size_t pending_ = 0;
+};
+
+/**
+ * @brief a coroutine that starts right away and is not awaited by anyone
+ */
+struct task {
+  struct promise_type {
+    task get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+/**
+ * @brief a child process whose pipe and exit are awaited through a reactor
+ *
+ * The processes are started with mypspawn, so any number of them can be
+ * running at the same time. The exit is watched through a pidfd; on kernels
+ * without pidfds co_await exit() blocks in waitpid.
+ */
+class process {
+  /**
+   * @brief base of the awaitables, completing right away if possible
+   */
+  template <typename Op> struct awaitable : pending_op {
+    reactor *loop;
+    ssize_t result = -1;
+    int error = 0;
+
+    bool await_ready() noexcept {
+      if (fd == -1) {
+        error = EBADF;
+        return true;
+      }
+      return Op::try_complete(this);
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) noexcept {
+      handle = h;
+      attempt = &Op::try_complete;
+      if (!loop->wait(this)) {
+        result = -1;
+        error = errno;
+        return false;
+      }
+      return true;
+    }
+
+    ssize_t await_resume() noexcept {
+      if (result == -1) {
+        errno = error;
+      }
+      return result;
+    }
+
+    /**
+     * @returns true if the operation is complete, false if it would block
+     */
+    bool complete(ssize_t n) noexcept {
+      if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return false;
+      }
+      result = n;
+      error = n == -1 ? errno : 0;
+      return true;
+    }
+  };
+
+public:
+  /**
+   * @brief co_await on it reads at most size bytes and yields their number, 0 at EOF
+   */
+  struct read_op : awaitable<read_op> {
+    void *buffer;
+    std::size_t size;
+
+    static bool try_complete(pending_op *op) noexcept {
+      read_op *self = static_cast<read_op *>(op);
+      ssize_t n;
+
+      while ((n = ::read(self->fd, self->buffer, self->size)) == -1 && errno == EINTR) {
+      }
+      return self->complete(n);
+    }
+  };
+
+  /**
+   * @brief co_await on it writes all size bytes and yields their number
+   */
+  struct write_op : awaitable<write_op> {
+    const char *buffer;
+    std::size_t size;
+    std::size_t done = 0;
+
+    static bool try_complete(pending_op *op) noexcept {
+      write_op *self = static_cast<write_op *>(op);
+
+      while (self->done < self->size) {
+        ssize_t n = ::write(self->fd, self->buffer + self->done, self->size - self->done);
+
+        if (n == -1) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return self->complete(-1);
+        }
+        self->done += static_cast<std::size_t>(n);
+      }
+      return self->complete(static_cast<ssize_t>(self->done));
+    }
+  };
+
+  /**
+   * @brief co_await on it yields the status returned by waitpid for the child
+   */
+  struct exit_op : awaitable<exit_op> {
+    pid_t pid;
+    int *wstatus;
+    bool *reaped;
+
+    static bool try_complete(pending_op *op) noexcept {
+      exit_op *self = static_cast<exit_op *>(op);
+      int options = self->fd == -2 ? 0 : WNOHANG;
+      pid_t wait_pid;
+
+      while ((wait_pid = waitpid(self->pid, self->wstatus, options)) == -1 && errno == EINTR) {
+      }
+      if (wait_pid == 0) {
+        errno = EAGAIN;
+        return self->complete(-1);
+      }
+      if (wait_pid == -1) {
+        return self->complete(-1);
+      }
+      *self->reaped = true;
+      return self->complete(*self->wstatus);
+    }
+  };
+
+  process() noexcept = default;
+
+  /**
+   * @brief start a child process driven by a reactor
+   *
+   * @param loop the reactor resuming the coroutines awaiting the process
+   * @param command the command to be executed
+   * @param type the I/O mode (r/w)
+   * @param attr the options for the child process (may be nullptr)
+   *
+   * @returns the process, which evaluates to false in case of error
+   */
+  static process spawn(reactor &loop, const char *command, const char *type,
+                       const mypopen_attr *attr = nullptr) noexcept {
+    process child;
+
+    child.loop_ = &loop;
+    if ((child.pid_ = mypspawn(command, type, attr, &child.fd_)) == -1) {
+      child.error_ = errno;
+      return child;
+    }
+    fcntl(child.fd_, F_SETFL, fcntl(child.fd_, F_GETFL) | O_NONBLOCK);
+#ifdef SYS_pidfd_open
+    child.pidfd_ = static_cast<int>(syscall(SYS_pidfd_open, child.pid_, 0));
+#endif
+    return child;
+  }
+
+  process(process &&other) noexcept { *this = static_cast<process &&>(other); }
+
+  process &operator=(process &&other) noexcept {
+    if (this != &other) {
+      release();
+      loop_ = other.loop_;
+      pid_ = other.pid_;
+      fd_ = other.fd_;
+      pidfd_ = other.pidfd_;
+      wstatus_ = other.wstatus_;
+      reaped_ = other.reaped_;
+      error_ = other.error_;
+      other.pid_ = -1;
+      other.fd_ = -1;
+      other.pidfd_ = -1;
+    }
+    return *this;
+  }
+
+  process(const process &) = delete;
+  process &operator=(const process &) = delete;
+
+  /**
+   * closes the pipe and, unless the exit has been awaited, blocks in waitpid
+   */
+  ~process() { release(); }
+
+  /**
+   * @returns whether the process could be started
+   */
+  explicit operator bool() const noexcept { return pid_ != -1; }
+
+  pid_t pid() const noexcept { return pid_; }
+
+  /**
+   * @returns the errno of a failed spawn or 0
+   */
+  int error() const noexcept { return error_; }
+
+  read_op read(void *buffer, std::size_t size) noexcept {
+    read_op op;
+
+    prepare(op, fd_, EPOLLIN);
+    op.buffer = buffer;
+    op.size = size;
+    return op;
+  }
+
+  write_op write(const void *buffer, std::size_t size) noexcept {
+    write_op op;
+
+    prepare(op, fd_, EPOLLOUT);
+    op.buffer = static_cast<const char *>(buffer);
+    op.size = size;
+    return op;
+  }
+
+  /**
+   * @brief close the pipe (so a child reading it sees EOF) and await the exit
+   */
+  exit_op exit() noexcept {
+    exit_op op;
+
+    close_pipe();
+    /* -2 makes the operation wait in waitpid if there is no pidfd */
+    prepare(op, pid_ == -1 ? -1 : (pidfd_ != -1 ? pidfd_ : -2), EPOLLIN);
+    op.pid = pid_;
+    op.wstatus = &wstatus_;
+    op.reaped = &reaped_;
+    return op;
+  }
+
+  /**
+   * @brief close the pipe to or from the child
+   */
+  void close_pipe() noexcept {
+    if (fd_ != -1) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  /**
+   * @brief send a signal to the child process (group with MYPOPEN_SETPGRP)
+   */
+  int kill(int signo, bool group = false) noexcept { return ::kill(group ? -pid_ : pid_, signo); }
+
+private:
+  template <typename Op> void prepare(Op &op, int fd, std::uint32_t events) noexcept {
+    op.loop = loop_;
+    op.fd = fd;
+    op.events = events;
+    op.handle = nullptr;
+    op.attempt = nullptr;
+  }
+
+  void release() noexcept {
+    close_pipe();
+    if (pidfd_ != -1) {
+      ::close(pidfd_);
+      pidfd_ = -1;
+    }
+    if (pid_ != -1) {
+      if (!reaped_) {
+        while (waitpid(pid_, &wstatus_, 0) == -1 && errno == EINTR) {
+        }
+      }
+      pid_ = -1;
+    }
+  }
+
+  reactor *loop_ = nullptr;
+  pid_t pid_ = -1;
+  int fd_ = -1;
+  int pidfd_ = -1;
+  int wstatus_ = 0;
+  bool reaped_ = false;
+  int error_ = 0;
+};
+
+} // namespace mypp
+
+#endif /* _MYPOPEN_CORO_HPP_ */
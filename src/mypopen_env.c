@@ -0,0 +1,286 @@
+#include "mypopen.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * the size of the arena of an environment that starts out empty
+ */
+#define INITIAL_ARENA_SIZE 4096
+
+/**
+ * the number of variables an environment that starts out empty has room for
+ */
+#define INITIAL_CAPACITY 32
+
+/**
+ * @brief get the length of the name of a variable
+ *
+ * @param var the variable (NAME=value)
+ *
+ * @returns the length of NAME
+ */
+static size_t name_length(const char *var) {
+  const char *equals = strchr(var, '=');
+
+  return equals != NULL ? (size_t)(equals - var) : strlen(var);
+}
+
+/**
+ * @brief find a variable
+ *
+ * @returns the index of the variable or count if there is none
+ */
+static size_t find(const struct mypenv *env, const char *name, size_t length) {
+  size_t i;
+
+  for (i = 0; i < env->count; ++i) {
+    const char *var = env->arena + env->offsets[i];
+
+    if (strncmp(var, name, length) == 0 && var[length] == '=') {
+      break;
+    }
+  }
+  return i;
+}
+
+/**
+ * @brief copy the live variables to the start of a fresh arena of the given size
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int rebuild_arena(struct mypenv *env, size_t size) {
+  char *arena;
+  size_t used = 0;
+  size_t i;
+
+  if ((arena = malloc(size)) == NULL) {
+    /* errno is set by malloc */
+    return -1;
+  }
+  for (i = 0; i < env->count; ++i) {
+    size_t length = strlen(env->arena + env->offsets[i]) + 1;
+
+    memcpy(arena + used, env->arena + env->offsets[i], length);
+    env->offsets[i] = used;
+    used += length;
+  }
+
+  free(env->arena);
+  env->arena = arena;
+  env->arena_size = size;
+  env->arena_used = used;
+  env->garbage = 0;
+  env->dirty = 1;
+
+  return 0;
+}
+
+/**
+ * @brief make room in the arena and the offsets for another variable
+ *
+ * The arena is compacted instead of grown if most of it is garbage.
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int reserve(struct mypenv *env, size_t length) {
+  if (env->count + 1 >= env->capacity) {
+    size_t capacity = env->capacity * 2;
+    size_t *offsets = realloc(env->offsets, capacity * sizeof(*offsets));
+
+    if (offsets == NULL) {
+      /* errno is set by realloc */
+      return -1;
+    }
+    env->offsets = offsets;
+    env->capacity = capacity;
+  }
+
+  if (env->arena_used + length > env->arena_size) {
+    size_t live = env->arena_used - env->garbage;
+    size_t size = env->arena_size;
+
+    while (size < live + length || (live + length) * 2 > size) {
+      size *= 2;
+    }
+    /* rebuilding shrinks the garbage away, growing alone would keep it */
+    if (rebuild_arena(env, size) == -1) {
+      /* errno is set by rebuild_arena */
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief initialize an environment for child processes
+ *
+ * The strings of all variables live in one arena and the array handed to
+ * execve is built only when the environment has changed, so using the same
+ * environment for any number of children allocates nothing.
+ *
+ * @param env the environment to be initialized
+ * @param base the variables to start with (e.g. environ) or NULL for none
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+int mypenv_init(struct mypenv *env, char *const *base) {
+  size_t count = 0, size = 0;
+  char *const *var;
+
+  for (var = base; var != NULL && *var != NULL; ++var) {
+    size += strlen(*var) + 1;
+    ++count;
+  }
+
+  memset(env, 0, sizeof(*env));
+  env->arena_size = size > INITIAL_ARENA_SIZE ? size * 2 : INITIAL_ARENA_SIZE;
+  env->capacity = count >= INITIAL_CAPACITY ? count * 2 : INITIAL_CAPACITY;
+  env->dirty = 1;
+
+  if ((env->arena = malloc(env->arena_size)) == NULL ||
+      (env->offsets = malloc(env->capacity * sizeof(*env->offsets))) == NULL) {
+    free(env->arena);
+    env->arena = NULL;
+    /* errno is set by malloc */
+    return -1;
+  }
+
+  for (var = base; var != NULL && *var != NULL; ++var) {
+    size_t length = strlen(*var) + 1;
+
+    memcpy(env->arena + env->arena_used, *var, length);
+    env->offsets[env->count++] = env->arena_used;
+    env->arena_used += length;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief set a variable, replacing its value if it exists
+ *
+ * @param env the environment
+ * @param name the name of the variable
+ * @param value the value of the variable
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+int mypenv_set(struct mypenv *env, const char *name, const char *value) {
+  size_t length = strlen(name);
+  size_t value_length = strlen(value);
+  size_t i;
+
+  if (length == 0 || strchr(name, '=') != NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (reserve(env, length + value_length + 2) == -1) {
+    /* errno is set by reserve */
+    return -1;
+  }
+
+  if ((i = find(env, name, length)) < env->count) {
+    env->garbage += strlen(env->arena + env->offsets[i]) + 1;
+  } else {
+    ++env->count;
+  }
+  env->offsets[i] = env->arena_used;
+
+  memcpy(env->arena + env->arena_used, name, length);
+  env->arena[env->arena_used + length] = '=';
+  memcpy(env->arena + env->arena_used + length + 1, value, value_length + 1);
+  env->arena_used += length + value_length + 2;
+  env->dirty = 1;
+
+  return 0;
+}
+
+/**
+ * @brief remove a variable
+ *
+ * @param env the environment
+ * @param name the name of the variable
+ *
+ * @returns 0 on success (also if there is no such variable) or -1 in case of error
+ */
+int mypenv_unset(struct mypenv *env, const char *name) {
+  size_t length = strlen(name);
+  size_t i;
+
+  if (length == 0 || strchr(name, '=') != NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if ((i = find(env, name, length)) < env->count) {
+    env->garbage += strlen(env->arena + env->offsets[i]) + 1;
+    memmove(&env->offsets[i], &env->offsets[i + 1], (env->count - i - 1) * sizeof(*env->offsets));
+    --env->count;
+    env->dirty = 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief get the value of a variable
+ *
+ * @param env the environment
+ * @param name the name of the variable
+ *
+ * @returns the value or NULL if there is no such variable
+ */
+const char *mypenv_get(const struct mypenv *env, const char *name) {
+  size_t length = name_length(name);
+  size_t i = find(env, name, length);
+
+  return i < env->count ? env->arena + env->offsets[i] + length + 1 : NULL;
+}
+
+/**
+ * @brief get the environment in the form taken by execve (and mypopen_attr.envp)
+ *
+ * The array stays valid until the environment is changed or destroyed.
+ *
+ * @param env the environment
+ *
+ * @returns the NULL-terminated array of variables or NULL in case of error
+ */
+char *const *mypenv_envp(struct mypenv *env) {
+  size_t i;
+
+  if (env->dirty) {
+    if (env->envp_capacity < env->count + 1) {
+      char **envp = realloc(env->envp, env->capacity * sizeof(*envp));
+
+      if (envp == NULL) {
+        /* errno is set by realloc */
+        return NULL;
+      }
+      env->envp = envp;
+      env->envp_capacity = env->capacity;
+    }
+    for (i = 0; i < env->count; ++i) {
+      env->envp[i] = env->arena + env->offsets[i];
+    }
+    env->envp[env->count] = NULL;
+    env->dirty = 0;
+  }
+
+  return env->envp;
+}
+
+/**
+ * @brief free the memory of an environment
+ *
+ * @param env the environment
+ */
+void mypenv_destroy(struct mypenv *env) {
+  free(env->arena);
+  free(env->offsets);
+  free(env->envp);
+  memset(env, 0, sizeof(*env));
+}
@@ -0,0 +1,324 @@
+#define _GNU_SOURCE /* O_PATH, execvpe */
+
+#include "mypopen_private.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/**
+ * the number of programs kept in the cache, each of them holds a file descriptor
+ */
+#define MAX_PROGRAMS 64
+
+/**
+ * the search path if PATH is not set, as used by execvp
+ */
+#define DEFAULT_PATH "/bin:/usr/bin"
+
+/**
+ * a program name resolved by searching PATH
+ */
+struct entry {
+  struct entry *next; /* the entry used next less recently */
+  char *name;         /* the name of the program */
+  char *path;         /* the path of the program or NULL if there is none */
+  int fd;             /* an O_PATH descriptor of the program or -1 */
+  dev_t dev;          /* the device of the program */
+  ino_t ino;          /* the inode of the program */
+  uint64_t stamp;     /* the state of the PATH directories if there is no program */
+};
+
+/**
+ * the cache of resolved programs, valid for the value of PATH it was filled with
+ */
+static struct {
+  pthread_mutex_t lock; /* protects the other members */
+  char *path_env;       /* the value of PATH the entries were resolved with */
+  struct entry *head;   /* the entry used most recently */
+  size_t count;         /* the number of entries */
+} programs = {PTHREAD_MUTEX_INITIALIZER, NULL, NULL, 0};
+
+/**
+ * @brief free an entry including its file descriptor
+ */
+static void free_entry(struct entry *entry) {
+  if (entry->fd != -1) {
+    close(entry->fd);
+  }
+  free(entry->name);
+  free(entry->path);
+  free(entry);
+}
+
+/**
+ * @brief drop all entries, programs.lock must be held
+ */
+static void clear(void) {
+  struct entry *entry, *next;
+
+  for (entry = programs.head; entry != NULL; entry = next) {
+    next = entry->next;
+    free_entry(entry);
+  }
+  programs.head = NULL;
+  programs.count = 0;
+}
+
+/**
+ * @brief get a fingerprint of the directories in a search path
+ *
+ * The fingerprint changes whenever a file is added to or removed from one
+ * of the directories, as that changes the mtime of the directory.
+ */
+static uint64_t path_stamp(const char *path_env) {
+  struct xxh64_state state;
+  char dir[PATH_MAX];
+  const char *p, *end;
+
+  mypopen_xxh64_init(&state);
+  for (p = path_env;; p = end + 1) {
+    struct stat st;
+    size_t length;
+
+    end = strchrnul(p, ':');
+    length = (size_t)(end - p) < sizeof(dir) ? (size_t)(end - p) : sizeof(dir) - 1;
+    memcpy(dir, p, length);
+    dir[length] = '\0';
+    if (stat(dir, &st) == 0) {
+      mypopen_xxh64_update(&state, (const unsigned char *)&st.st_dev, sizeof(st.st_dev));
+      mypopen_xxh64_update(&state, (const unsigned char *)&st.st_ino, sizeof(st.st_ino));
+      mypopen_xxh64_update(&state, (const unsigned char *)&st.st_mtim, sizeof(st.st_mtim));
+    } else {
+      mypopen_xxh64_update(&state, (const unsigned char *)&errno, sizeof(errno));
+    }
+    if (*end == '\0') {
+      break;
+    }
+  }
+
+  return mypopen_xxh64_digest(&state);
+}
+
+/**
+ * @brief search a program in PATH like execvp does
+ *
+ * @param name the name of the program
+ * @param path_env the search path
+ * @param entry where to store the program found
+ *
+ * @returns 1 if found, 0 if not found or -1 if the result depends on the
+ *          working directory (a relative directory in PATH) and cannot be cached
+ */
+static int search(const char *name, const char *path_env, struct entry *entry) {
+  char candidate[PATH_MAX];
+  const char *p, *end;
+
+  for (p = path_env;; p = end + 1) {
+    struct stat st;
+    int fd;
+
+    end = strchrnul(p, ':');
+    if (*p != '/') {
+      /* an empty or relative directory means the working directory of the child */
+      return -1;
+    }
+    if ((size_t)snprintf(candidate, sizeof(candidate), "%.*s/%s", (int)(end - p), p, name) <
+            sizeof(candidate) &&
+        access(candidate, X_OK) == 0 &&
+        (fd = open(candidate, O_PATH | O_CLOEXEC)) != -1) {
+      if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (entry->path = strdup(candidate)) != NULL) {
+        entry->fd = fd;
+        entry->dev = st.st_dev;
+        entry->ino = st.st_ino;
+        return 1;
+      }
+      close(fd);
+    }
+    if (*end == '\0') {
+      return 0;
+    }
+  }
+}
+
+/**
+ * @brief fill in the program for the child from an entry
+ *
+ * The descriptor is duplicated, so the entry can be evicted by another
+ * thread while the child is being created.
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+static int use_entry(const struct entry *entry, struct program *program) {
+  if ((program->fd = fcntl(entry->fd, F_DUPFD_CLOEXEC, 0)) == -1) {
+    /* errno is set by fcntl */
+    return -1;
+  }
+  /* the path fits, it was built in a buffer of the same size */
+  strcpy(program->path, entry->path);
+  return 0;
+}
+
+/**
+ * @brief resolve the program to be executed by a child without a shell
+ *
+ * Names without a slash are searched in PATH. The result is cached, positive
+ * results as an O_PATH descriptor that is checked against the inode at the
+ * path on every use, negative ones until a PATH directory changes. The cache
+ * is dropped when PATH changes.
+ *
+ * @param name the name or path of the program
+ * @param program where to store the program, to be released with mypopen_program_release
+ *
+ * @returns 0 on success or -1 in case of error (errno is ENOENT if there is no such program)
+ */
+int mypopen_program_resolve(const char *name, struct program *program) {
+  const char *path_env = getenv("PATH");
+  struct entry *entry, **link;
+  struct stat st;
+  int saved_errno;
+  int found;
+
+  program->fd = -1;
+  program->path[0] = '\0';
+
+  if (*name == '\0') {
+    errno = ENOENT;
+    return -1;
+  }
+  if (strchr(name, '/') != NULL) {
+    /* executed as given, relative to the working directory of the child */
+    if (strlen(name) >= sizeof(program->path)) {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+    strcpy(program->path, name);
+    return 0;
+  }
+  if (path_env == NULL) {
+    path_env = DEFAULT_PATH;
+  }
+
+  pthread_mutex_lock(&programs.lock);
+
+  if (programs.path_env == NULL || strcmp(programs.path_env, path_env) != 0) {
+    clear();
+    free(programs.path_env);
+    programs.path_env = strdup(path_env);
+  }
+
+  for (link = &programs.head; *link != NULL; link = &(*link)->next) {
+    if (strcmp((*link)->name, name) != 0) {
+      continue;
+    }
+    entry = *link;
+
+    /* still valid if the same file is at the path or the directories have not changed */
+    if (entry->path != NULL ? stat(entry->path, &st) == 0 && st.st_dev == entry->dev &&
+                                  st.st_ino == entry->ino
+                            : path_stamp(path_env) == entry->stamp) {
+      *link = entry->next;
+      entry->next = programs.head;
+      programs.head = entry;
+      goto found;
+    }
+    *link = entry->next;
+    free_entry(entry);
+    --programs.count;
+    break;
+  }
+
+  if ((entry = calloc(1, sizeof(*entry))) == NULL || (entry->name = strdup(name)) == NULL) {
+    free(entry);
+    pthread_mutex_unlock(&programs.lock);
+    errno = ENOMEM;
+    return -1;
+  }
+  entry->fd = -1;
+  /* taken before searching, so a program installed meanwhile is found the next time */
+  entry->stamp = path_stamp(path_env);
+
+  if ((found = search(name, path_env, entry)) == -1) {
+    /* leave the search to the child */
+    free_entry(entry);
+    pthread_mutex_unlock(&programs.lock);
+    return 0;
+  }
+
+  entry->next = programs.head;
+  programs.head = entry;
+  if (++programs.count > MAX_PROGRAMS) {
+    for (link = &programs.head; (*link)->next != NULL; link = &(*link)->next) {
+    }
+    free_entry(*link);
+    *link = NULL;
+    --programs.count;
+  }
+
+found:
+  if (entry->path == NULL) {
+    pthread_mutex_unlock(&programs.lock);
+    errno = ENOENT;
+    return -1;
+  }
+  if (use_entry(entry, program) == -1) {
+    saved_errno = errno;
+    pthread_mutex_unlock(&programs.lock);
+    errno = saved_errno;
+    return -1;
+  }
+
+  pthread_mutex_unlock(&programs.lock);
+  return 0;
+}
+
+/**
+ * @brief release what mypopen_program_resolve has set up for the child
+ */
+void mypopen_program_release(struct program *program) {
+  if (program->fd != -1) {
+    close(program->fd);
+    program->fd = -1;
+  }
+}
+
+/**
+ * @brief execute a resolved program, returning only if that fails
+ *
+ * Called in the child process after fork.
+ *
+ * @param program the program resolved by mypopen_program_resolve
+ * @param name the name of the program, searched in PATH if it could not be resolved
+ * @param argv the arguments
+ * @param envp the environment
+ */
+void mypopen_program_exec(const struct program *program, const char *name,
+                          char *const *argv, char *const *envp) {
+#ifdef SYS_execveat
+  if (program->fd != -1) {
+    syscall(SYS_execveat, program->fd, "", argv, envp, AT_EMPTY_PATH);
+    /* scripts cannot be executed through a close-on-exec descriptor, they can through the path */
+  }
+#endif
+  if (program->path[0] != '\0') {
+    execve(program->path, argv, envp);
+  } else {
+    execvpe(name, argv, envp);
+  }
+}
+
+/**
+ * @brief drop the programs resolved for executing children without a shell
+ *
+ * This closes the O_PATH descriptors held for them.
+ */
+void mypopen_forget_programs(void) {
+  pthread_mutex_lock(&programs.lock);
+  clear();
+  free(programs.path_env);
+  programs.path_env = NULL;
+  pthread_mutex_unlock(&programs.lock);
+}
@@ -0,0 +1,435 @@
+#include "mypopen_private.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/**
+ * the buffer size used by mypline_init if the caller passes 0
+ */
+#define DEFAULT_BUFFER_SIZE (64 * 1024)
+
+/**
+ * @brief find the first newline in a range of bytes one byte at a time
+ *
+ * @param p the start of the range
+ * @param end the end of the range
+ *
+ * @returns a pointer to the newline or NULL if there is none
+ */
+static const char *find_newline_scalar(const char *p, const char *end) {
+  for (; p < end; ++p) {
+    if (*p == '\n') {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+#ifdef __SSE2__
+/**
+ * @brief find the first newline in a range of bytes 16 bytes at a time
+ */
+static const char *find_newline_sse2(const char *p, const char *end) {
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  for (; end - p >= 16; p += 16) {
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), newline));
+
+    if (mask != 0) {
+      return p + __builtin_ctz((unsigned int)mask);
+    }
+  }
+  return find_newline_scalar(p, end);
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/**
+ * @brief find the first newline in a range of bytes 32 bytes at a time
+ */
+__attribute__((target("avx2"))) static const char *find_newline_avx2(const char *p,
+                                                                     const char *end) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+
+  for (; end - p >= 32; p += 32) {
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), newline));
+
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return find_newline_sse2(p, end);
+}
+#endif
+
+/**
+ * @brief count the newlines in a range of bytes one byte at a time
+ *
+ * @param p the start of the range
+ * @param end the end of the range
+ *
+ * @returns the number of newlines
+ */
+static uint64_t count_newlines_scalar(const char *p, const char *end) {
+  uint64_t count = 0;
+
+  for (; p < end; ++p) {
+    count += *p == '\n';
+  }
+  return count;
+}
+
+#ifdef __SSE2__
+/**
+ * @brief count the newlines in a range of bytes 16 bytes at a time
+ */
+static uint64_t count_newlines_sse2(const char *p, const char *end) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  uint64_t count = 0;
+
+  for (; end - p >= 16; p += 16) {
+    count += (uint64_t)__builtin_popcount((unsigned int)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), newline)));
+  }
+  return count + count_newlines_scalar(p, end);
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/**
+ * @brief count the newlines in a range of bytes 32 bytes at a time
+ */
+__attribute__((target("avx2,popcnt"))) static uint64_t count_newlines_avx2(const char *p,
+                                                                          const char *end) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+  uint64_t count = 0;
+
+  for (; end - p >= 32; p += 32) {
+    count += (uint64_t)__builtin_popcount((unsigned int)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), newline)));
+  }
+  return count + count_newlines_sse2(p, end);
+}
+#endif
+
+/**
+ * the newline scanners for this CPU, resolved by resolve_scanners before main runs
+ */
+static const char *(*find_newline)(const char *, const char *) = find_newline_scalar;
+static uint64_t (*count_newlines)(const char *, const char *) = count_newlines_scalar;
+
+/**
+ * @brief pick the fastest newline scanners supported by the CPU
+ *
+ * Run as a constructor while the process is still single-threaded, so the
+ * pointers never change while a reader may be using them. Until then the
+ * scalar scanners are used.
+ */
+__attribute__((constructor)) static void resolve_scanners(void) {
+#if defined(__x86_64__) && defined(__GNUC__)
+  /* constructors may run before the one of libgcc filling in the CPU model */
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    find_newline = find_newline_avx2;
+    count_newlines = count_newlines_avx2;
+  } else {
+    find_newline = find_newline_sse2;
+    count_newlines = count_newlines_sse2;
+  }
+#elif defined(__SSE2__)
+  find_newline = find_newline_sse2;
+  count_newlines = count_newlines_sse2;
+#endif
+}
+
+/**
+ * @brief initialize a reader yielding the lines read from a file descriptor
+ *
+ * The reader reads from the file descriptor directly, so the FILE * of a
+ * pipe must not be read from while the reader is in use.
+ *
+ * @param reader the reader to be initialized
+ * @param fd the file descriptor to read from
+ * @param size the initial size of the buffer or 0 for the default
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+int mypline_init(struct mypline_reader *reader, int fd, size_t size) {
+  reader->fd = fd;
+  reader->size = size != 0 ? size : DEFAULT_BUFFER_SIZE;
+  reader->start = reader->end = reader->scanned = 0;
+  reader->eof = 0;
+
+  if ((reader->buffer = mypopen_slab_alloc(reader->size)) == NULL) {
+    /* errno is set by malloc */
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief get the next line
+ *
+ * The line is not copied but points into the buffer of the reader. It stays
+ * valid until the next call and includes the trailing newline, unless it is
+ * the last line and the data did not end with one. Lines longer than the
+ * buffer make the buffer grow, they are never split.
+ *
+ * @param reader the reader
+ * @param line where to store the start of the line
+ *
+ * @returns the length of the line, 0 at the end of the data or -1 in case of error
+ */
+ssize_t mypline_next(struct mypline_reader *reader, const char **line) {
+  const char *newline;
+  size_t length;
+  ssize_t n;
+
+  for (;;) {
+    /* look for the end of the line in the data not scanned yet */
+    newline = find_newline(reader->buffer + reader->start + reader->scanned,
+                           reader->buffer + reader->end);
+    if (newline != NULL) {
+      length = (size_t)(newline + 1 - (reader->buffer + reader->start));
+      break;
+    }
+    reader->scanned = reader->end - reader->start;
+
+    if (reader->eof) {
+      /* the last line might lack a newline */
+      length = reader->scanned;
+      break;
+    }
+
+    /* move the partial line to the front and grow the buffer if it fills it */
+    if (reader->start > 0) {
+      memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+      reader->end -= reader->start;
+      reader->start = 0;
+    }
+    if (reader->end == reader->size) {
+      char *buffer = realloc(reader->buffer, reader->size * 2);
+
+      if (buffer == NULL) {
+        /* errno is set by realloc */
+        return -1;
+      }
+      reader->buffer = buffer;
+      reader->size *= 2;
+    }
+
+    while ((n = read(reader->fd, reader->buffer + reader->end, reader->size - reader->end)) ==
+               -1 &&
+           errno == EINTR) {
+    }
+    if (n == -1) {
+      /* errno is set by read */
+      return -1;
+    }
+    if (n == 0) {
+      reader->eof = 1;
+    }
+    reader->end += (size_t)n;
+    mypopen_stats_collected((size_t)n);
+  }
+
+  *line = reader->buffer + reader->start;
+  reader->start += length;
+  reader->scanned = 0;
+
+  return (ssize_t)length;
+}
+
+/**
+ * @brief free the buffer of a reader (the file descriptor is not closed)
+ *
+ * @param reader the reader
+ */
+void mypline_destroy(struct mypline_reader *reader) {
+  mypopen_slab_free(reader->buffer, reader->size);
+  reader->buffer = NULL;
+}
+
+/* the primes of XXH64 */
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline uint64_t read64(const unsigned char *p) {
+  uint64_t value;
+
+  memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap64(value);
+#endif
+  return value;
+}
+
+static inline uint32_t read32(const unsigned char *p) {
+  uint32_t value;
+
+  memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap32(value);
+#endif
+  return value;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+  return rotl64(acc + input * PRIME64_2, 31) * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t hash, uint64_t acc) {
+  return (hash ^ xxh64_round(0, acc)) * PRIME64_1 + PRIME64_4;
+}
+
+/**
+ * @brief start a hash
+ */
+void mypopen_xxh64_init(struct xxh64_state *state) {
+  state->total = 0;
+  state->acc[0] = PRIME64_1 + PRIME64_2;
+  state->acc[1] = PRIME64_2;
+  state->acc[2] = 0;
+  state->acc[3] = -PRIME64_1;
+  state->tail_size = 0;
+}
+
+/**
+ * @brief hash a stripe of 32 bytes
+ */
+static inline void xxh64_stripe(uint64_t acc[4], const unsigned char *p) {
+  acc[0] = xxh64_round(acc[0], read64(p));
+  acc[1] = xxh64_round(acc[1], read64(p + 8));
+  acc[2] = xxh64_round(acc[2], read64(p + 16));
+  acc[3] = xxh64_round(acc[3], read64(p + 24));
+}
+
+/**
+ * @brief add the next piece of data to a hash
+ */
+void mypopen_xxh64_update(struct xxh64_state *state, const unsigned char *p, size_t size) {
+  const unsigned char *end = p + size;
+
+  state->total += size;
+
+  /* complete the stripe left over from the last piece first */
+  if (state->tail_size > 0) {
+    size_t missing = sizeof(state->tail) - state->tail_size;
+
+    if (size < missing) {
+      memcpy(state->tail + state->tail_size, p, size);
+      state->tail_size += size;
+      return;
+    }
+    memcpy(state->tail + state->tail_size, p, missing);
+    xxh64_stripe(state->acc, state->tail);
+    p += missing;
+    state->tail_size = 0;
+  }
+
+  for (; end - p >= 32; p += 32) {
+    xxh64_stripe(state->acc, p);
+  }
+
+  memcpy(state->tail, p, (size_t)(end - p));
+  state->tail_size = (size_t)(end - p);
+}
+
+/**
+ * @returns the hash of all the data added
+ */
+uint64_t mypopen_xxh64_digest(const struct xxh64_state *state) {
+  const unsigned char *p = state->tail;
+  const unsigned char *end = p + state->tail_size;
+  uint64_t hash;
+
+  if (state->total >= 32) {
+    hash = rotl64(state->acc[0], 1) + rotl64(state->acc[1], 7) + rotl64(state->acc[2], 12) +
+           rotl64(state->acc[3], 18);
+    hash = xxh64_merge(hash, state->acc[0]);
+    hash = xxh64_merge(hash, state->acc[1]);
+    hash = xxh64_merge(hash, state->acc[2]);
+    hash = xxh64_merge(hash, state->acc[3]);
+  } else {
+    hash = PRIME64_5;
+  }
+  hash += state->total;
+
+  for (; end - p >= 8; p += 8) {
+    hash = rotl64(hash ^ xxh64_round(0, read64(p)), 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (end - p >= 4) {
+    hash = rotl64(hash ^ (uint64_t)read32(p) * PRIME64_1, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    hash = rotl64(hash ^ *p * PRIME64_5, 11) * PRIME64_1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= PRIME64_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+/**
+ * @brief read a stream up to its end, keeping only statistics of the data
+ *
+ * The data is read in large blocks (stdio passes reads this big straight to
+ * the file descriptor) and counted and hashed while it is still in the cache.
+ * The stream is not closed.
+ *
+ * @param stream the stream to read from, e.g. as returned by mypopen
+ * @param stats where to store the statistics of the data
+ *
+ * @returns 0 on success or -1 in case of error
+ */
+int mypdrain(FILE *stream, struct mypdrain_stats *stats) {
+  struct xxh64_state state;
+  char *buffer;
+  size_t n;
+
+  if (stream == NULL || stats == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if ((buffer = mypopen_slab_alloc(DEFAULT_BUFFER_SIZE)) == NULL) {
+    /* errno is set by malloc */
+    return -1;
+  }
+
+  stats->lines = 0;
+  mypopen_xxh64_init(&state);
+
+  while ((n = fread(buffer, 1, DEFAULT_BUFFER_SIZE, stream)) > 0) {
+    stats->lines += count_newlines(buffer, buffer + n);
+    mypopen_xxh64_update(&state, (const unsigned char *)buffer, n);
+  }
+  mypopen_slab_free(buffer, DEFAULT_BUFFER_SIZE);
+
+  stats->bytes = state.total;
+  mypopen_stats_collected(state.total);
+  stats->hash = mypopen_xxh64_digest(&state);
+
+  if (ferror(stream)) {
+    /* errno is set by fread */
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef _MYPOPEN_PRIVATE_H_
+#define _MYPOPEN_PRIVATE_H_
+
+/*
+ * functions shared between the source files of the library, not part of its
+ * interface: they are prefixed with mypopen_ not to clash with the symbols of
+ * programs linking the static library, and hidden from a shared one
+ */
+
+#include "mypopen.h"
+
+#include <limits.h>
+
+#pragma GCC visibility push(hidden)
+
+/**
+ * the state of an XXH64 hash computed over data arriving in pieces
+ */
+struct xxh64_state {
+  uint64_t total;         /* the number of bytes hashed */
+  uint64_t acc[4];        /* the accumulators of the 32 byte stripes */
+  unsigned char tail[32]; /* the bytes not making up a full stripe yet */
+  size_t tail_size;       /* the number of bytes in tail */
+};
+
+void mypopen_xxh64_init(struct xxh64_state *state);
+void mypopen_xxh64_update(struct xxh64_state *state, const unsigned char *p, size_t size);
+uint64_t mypopen_xxh64_digest(const struct xxh64_state *state);
+
+/**
+ * the key the output of a command is cached under
+ */
+struct cache_key {
+  char *data;    /* the command followed by whatever else is part of the key */
+  size_t size;   /* the size of data */
+  uint64_t hash; /* the XXH64 hash of data */
+};
+
+int mypopen_cache_lookup(const char *command, const char *type,
+                         const struct mypopen_attr *attr, struct cache_key *key);
+int mypopen_cache_capture(struct cache_key *key, int *fd);
+void mypopen_cache_commit(int status);
+void mypopen_cache_discard(void);
+
+void *mypopen_slab_alloc(size_t size);
+void mypopen_slab_free(void *block, size_t size);
+
+void mypopen_stats_spawned(void);
+void mypopen_stats_spawn_failed(int error);
+void mypopen_stats_started(void);
+void mypopen_stats_released(void);
+void mypopen_stats_collected(size_t bytes);
+void mypopen_stats_stdin(size_t bytes);
+void mypopen_stats_close_timeout(void);
+unsigned int mypopen_stream_zombies(void);
+int mypopen_create_capture_file(void);
+
+/**
+ * the program a child executes without a shell, as resolved by mypopen_program_resolve
+ */
+struct program {
+  int fd;              /* an O_PATH descriptor of the program or -1 */
+  char path[PATH_MAX]; /* the path of the program or "" to search PATH in the child */
+};
+
+int mypopen_program_resolve(const char *name, struct program *program);
+void mypopen_program_release(struct program *program);
+void mypopen_program_exec(const struct program *program, const char *name,
+                          char *const *argv, char *const *envp);
+
+#pragma GCC visibility pop
+
+#endif /* _MYPOPEN_PRIVATE_H_ */
@@ -0,0 +1,140 @@
+#include "mypopen_private.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/**
+ * the smallest block size served from the caches, as a power of two
+ */
+#define MIN_SHIFT 12
+
+/**
+ * the number of block sizes served from the caches (4 KiB to 64 KiB)
+ */
+#define CLASSES 5
+
+/**
+ * the number of blocks of each size a thread keeps for reuse
+ */
+#define CACHED_BLOCKS 4
+
+/**
+ * the blocks a thread keeps for reuse, one list per block size
+ */
+struct slab_cache {
+  void *blocks[CLASSES][CACHED_BLOCKS]; /* the free blocks */
+  unsigned int count[CLASSES];          /* the number of free blocks of each size */
+  int registered;                       /* set once the cache is freed on thread exit */
+};
+
+/**
+ * the cache of the calling thread
+ */
+static __thread struct slab_cache cache;
+
+/**
+ * the key whose destructor frees the cache of an exiting thread
+ */
+static pthread_key_t cache_key;
+
+/**
+ * set if cache_key has been created
+ */
+static int cache_key_created = 0;
+
+/**
+ * makes sure cache_key is created only once
+ */
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief free the blocks kept by a thread
+ *
+ * @param data the cache of the thread
+ */
+static void release_cache(void *data) {
+  struct slab_cache *thread_cache = data;
+  unsigned int i;
+
+  for (i = 0; i < CLASSES; ++i) {
+    while (thread_cache->count[i] > 0) {
+      free(thread_cache->blocks[i][--thread_cache->count[i]]);
+    }
+  }
+  /* blocks freed by later destructors register the cache again */
+  thread_cache->registered = 0;
+}
+
+/**
+ * @brief create cache_key
+ */
+static void create_key(void) {
+  cache_key_created = pthread_key_create(&cache_key, release_cache) == 0;
+}
+
+/**
+ * @brief get the size class of a block size
+ *
+ * @returns the class or -1 if blocks of this size are not cached
+ */
+static int size_class(size_t size) {
+  int i;
+
+  for (i = 0; i < CLASSES; ++i) {
+    if (size == (size_t)1 << (MIN_SHIFT + i)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief allocate a block, reusing one freed by the calling thread if possible
+ *
+ * Buffers of the sizes used per child (stdio and line buffers) are kept in a
+ * small cache of each thread, so creating a child after another does not go
+ * to malloc and its arena locks again. Blocks of other sizes come from malloc.
+ * The block is ordinary heap memory and may be resized with realloc or freed
+ * with free, mypopen_slab_free just gives the cache a chance to keep it.
+ *
+ * @param size the size of the block
+ *
+ * @returns the block or NULL in case of error
+ */
+void *mypopen_slab_alloc(size_t size) {
+  int i = size_class(size);
+
+  if (i != -1 && cache.count[i] > 0) {
+    return cache.blocks[i][--cache.count[i]];
+  }
+  return malloc(size);
+}
+
+/**
+ * @brief free a block, keeping it in the cache of the calling thread if there is room
+ *
+ * @param block the block allocated by mypopen_slab_alloc or malloc (may be NULL)
+ * @param size the size of the block
+ */
+void mypopen_slab_free(void *block, size_t size) {
+  int i = size_class(size);
+
+  if (block == NULL) {
+    return;
+  }
+  if (i == -1 || cache.count[i] == CACHED_BLOCKS) {
+    free(block);
+    return;
+  }
+
+  if (!cache.registered) {
+    pthread_once(&cache_key_once, create_key);
+    if (!cache_key_created || pthread_setspecific(cache_key, &cache) != 0) {
+      /* nothing is kept that could not be freed on thread exit */
+      free(block);
+      return;
+    }
+    cache.registered = 1;
+  }
+  cache.blocks[i][cache.count[i]++] = block;
+}
@@ -0,0 +1,270 @@
+#include "mypopen_private.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * the alignment of the counters of a thread, so no two threads write to the same cache line
+ */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * the counters of one thread, written by that thread only
+ */
+struct counters {
+  struct counters *next;                  /* the counters of the next thread */
+  uint64_t spawns;                        /* children created */
+  uint64_t spawn_failures;                /* attempts to create a child that failed */
+  uint64_t spawn_errors[MYPSTATS_ERRNOS]; /* the failures by errno */
+  uint64_t started;                       /* children the library waits for itself */
+  uint64_t released;                      /* of these, the ones waited for or given up */
+  uint64_t bytes_collected;               /* output read from children by the library */
+  uint64_t bytes_stdin;                   /* bytes given to children as stdin_data */
+  uint64_t close_timeouts;                /* children mypclose_timeout had to signal */
+};
+
+/**
+ * the counters of all threads
+ */
+static struct {
+  pthread_mutex_t lock;    /* protects the other members, never taken for counting */
+  struct counters *head;   /* the counters of the running threads */
+  struct counters retired; /* the sums of the threads that have exited */
+} registry = {PTHREAD_MUTEX_INITIALIZER, NULL, {0}};
+
+/**
+ * the counters of the calling thread or NULL if it has not counted anything yet
+ */
+static __thread struct counters *mine = NULL;
+
+/**
+ * the key whose destructor retires the counters of an exiting thread
+ */
+static pthread_key_t counters_key;
+
+/**
+ * set if counters_key has been created
+ */
+static int counters_key_created = 0;
+
+/**
+ * makes sure counters_key is created only once
+ */
+static pthread_once_t counters_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief read a counter that may be written by another thread
+ */
+static uint64_t load(const uint64_t *counter) { return __atomic_load_n(counter, __ATOMIC_RELAXED); }
+
+/**
+ * @brief add the counters of a thread to a sum
+ */
+static void add_counters(struct counters *sum, const struct counters *counters) {
+  size_t i;
+
+  sum->spawns += load(&counters->spawns);
+  sum->spawn_failures += load(&counters->spawn_failures);
+  for (i = 0; i < MYPSTATS_ERRNOS; ++i) {
+    sum->spawn_errors[i] += load(&counters->spawn_errors[i]);
+  }
+  sum->started += load(&counters->started);
+  sum->released += load(&counters->released);
+  sum->bytes_collected += load(&counters->bytes_collected);
+  sum->bytes_stdin += load(&counters->bytes_stdin);
+  sum->close_timeouts += load(&counters->close_timeouts);
+}
+
+/**
+ * @brief move the counters of an exiting thread to the retired sums
+ *
+ * @param data the counters of the thread
+ */
+static void retire(void *data) {
+  struct counters *counters = data;
+  struct counters **link;
+
+  pthread_mutex_lock(&registry.lock);
+  for (link = &registry.head; *link != NULL; link = &(*link)->next) {
+    if (*link == counters) {
+      *link = counters->next;
+      break;
+    }
+  }
+  add_counters(&registry.retired, counters);
+  pthread_mutex_unlock(&registry.lock);
+
+  free(counters);
+  mine = NULL;
+}
+
+/**
+ * @brief create counters_key
+ */
+static void create_key(void) {
+  counters_key_created = pthread_key_create(&counters_key, retire) == 0;
+}
+
+/**
+ * @brief get the counters of the calling thread, registering them on first use
+ *
+ * @returns the counters or NULL if they cannot be allocated (nothing is counted then)
+ */
+static struct counters *thread_counters(void) {
+  struct counters *counters;
+
+  if (mine != NULL) {
+    return mine;
+  }
+
+  pthread_once(&counters_key_once, create_key);
+  if (!counters_key_created ||
+      posix_memalign((void **)&counters, CACHE_LINE_SIZE, sizeof(*counters)) != 0) {
+    return NULL;
+  }
+  memset(counters, 0, sizeof(*counters));
+  if (pthread_setspecific(counters_key, counters) != 0) {
+    free(counters);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&registry.lock);
+  counters->next = registry.head;
+  registry.head = counters;
+  pthread_mutex_unlock(&registry.lock);
+
+  return mine = counters;
+}
+
+/**
+ * @brief increase a counter of the calling thread
+ *
+ * Only the owning thread writes, so a plain store is enough; it is atomic
+ * only so that snapshots read whole values.
+ */
+static void add(uint64_t *counter, uint64_t n) {
+  __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief count a child created
+ */
+void mypopen_stats_spawned(void) {
+  struct counters *c = thread_counters();
+
+  if (c != NULL) {
+    add(&c->spawns, 1);
+  }
+}
+
+/**
+ * @brief count a failed attempt to create a child
+ *
+ * @param error the errno of the failure
+ */
+void mypopen_stats_spawn_failed(int error) {
+  struct counters *c = thread_counters();
+
+  if (c != NULL) {
+    add(&c->spawn_failures, 1);
+    add(&c->spawn_errors[error > 0 && error < MYPSTATS_ERRNOS ? error : 0], 1);
+  }
+}
+
+/**
+ * @brief count a child the library waits for itself (mypopen, mypcapture, mypbatch)
+ */
+void mypopen_stats_started(void) {
+  struct counters *c = thread_counters();
+
+  if (c != NULL) {
+    add(&c->started, 1);
+  }
+}
+
+/**
+ * @brief count a child counted by mypopen_stats_started that has been waited for or given up
+ */
+void mypopen_stats_released(void) {
+  struct counters *c = thread_counters();
+
+  if (c != NULL) {
+    add(&c->released, 1);
+  }
+}
+
+/**
+ * @brief count output of children read by the library itself
+ */
+void mypopen_stats_collected(size_t bytes) {
+  struct counters *c = thread_counters();
+
+  if (c != NULL) {
+    add(&c->bytes_collected, bytes);
+  }
+}
+
+/**
+ * @brief count bytes given to children as stdin_data
+ */
+void mypopen_stats_stdin(size_t bytes) {
+  struct counters *c = thread_counters();
+
+  if (c != NULL) {
+    add(&c->bytes_stdin, bytes);
+  }
+}
+
+/**
+ * @brief count a child that mypclose_timeout had to signal
+ */
+void mypopen_stats_close_timeout(void) {
+  struct counters *c = thread_counters();
+
+  if (c != NULL) {
+    add(&c->close_timeouts, 1);
+  }
+}
+
+/**
+ * @brief get the statistics of the library
+ *
+ * Every thread counts in counters of its own, so counting takes no lock and
+ * shares no cache line with other threads; the snapshot sums them up. As the
+ * threads keep counting meanwhile, the counters of a snapshot are not taken
+ * at exactly the same instant.
+ *
+ * The byte counters cover only what the library reads and writes itself:
+ * the output collected by mypline_next, mypdrain, mypbatch and mypcapture,
+ * and the stdin_data given to children. What the caller reads from or
+ * writes to the stream of mypopen goes through stdio and is not counted,
+ * as the stream is a plain FILE with a file descriptor. Active children
+ * are those of mypopen, mypcapture and mypbatch that have not been waited
+ * for yet; mypspawn leaves waiting to the caller.
+ *
+ * @param stats where to store the statistics
+ */
+void mypstats_snapshot(struct mypstats *stats) {
+  struct counters sum;
+  struct counters *counters;
+
+  memset(&sum, 0, sizeof(sum));
+
+  pthread_mutex_lock(&registry.lock);
+  add_counters(&sum, &registry.retired);
+  for (counters = registry.head; counters != NULL; counters = counters->next) {
+    add_counters(&sum, counters);
+  }
+  pthread_mutex_unlock(&registry.lock);
+
+  stats->spawns = sum.spawns;
+  stats->spawn_failures = sum.spawn_failures;
+  memcpy(stats->spawn_errors, sum.spawn_errors, sizeof(stats->spawn_errors));
+  /* a child may be released by another thread than the one that started it */
+  stats->active = sum.started > sum.released ? sum.started - sum.released : 0;
+  stats->zombies = mypopen_stream_zombies();
+  stats->bytes_collected = sum.bytes_collected;
+  stats->bytes_stdin = sum.bytes_stdin;
+  stats->close_timeouts = sum.close_timeouts;
+}
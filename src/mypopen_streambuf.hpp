@@ -0,0 +1,178 @@
+#ifndef _MYPOPEN_STREAMBUF_HPP_
+#define _MYPOPEN_STREAMBUF_HPP_
+
+#include "mypopen.h"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <streambuf>
+
+namespace mypp {
+
+/**
+ * @brief a stream buffer reading from or writing to a pipe of mypopen
+ *
+ * The buffer works on the file descriptor of the pipe directly, so the data
+ * is not buffered by stdio a second time. Bulk transfers of at least the
+ * size of the buffer bypass the buffer altogether. The FILE * of the pipe
+ * must not be used for I/O while the buffer is in use, and the buffer has to
+ * be destroyed (or synced) before the pipe is closed.
+ */
+class pipebuf : public std::streambuf {
+public:
+  static constexpr std::size_t default_size = 64 * 1024;
+
+  /**
+   * @brief create a buffer for the pipe stream returned by mypopen
+   *
+   * @param stream the pipe stream, the direction is taken from its file descriptor
+   * @param size the size of the buffer in bytes
+   */
+  explicit pipebuf(FILE *stream, std::size_t size = default_size)
+      : pipebuf(fileno(stream), size) {}
+
+  /**
+   * @brief create a buffer for a file descriptor opened for either reading or writing
+   *
+   * @param fd the file descriptor
+   * @param size the size of the buffer in bytes
+   */
+  explicit pipebuf(int fd, std::size_t size = default_size)
+      : fd_(fd), size_(std::max<std::size_t>(size, 1)), buffer_(new char[size_]),
+        writing_((fcntl(fd, F_GETFL) & O_ACCMODE) == O_WRONLY) {
+    if (writing_) {
+      setp(buffer_.get(), buffer_.get() + size_);
+    } else {
+      setg(buffer_.get(), buffer_.get(), buffer_.get());
+    }
+  }
+
+  pipebuf(const pipebuf &) = delete;
+  pipebuf &operator=(const pipebuf &) = delete;
+
+  ~pipebuf() override { sync(); }
+
+protected:
+  int_type underflow() override {
+    if (gptr() < egptr()) {
+      return traits_type::to_int_type(*gptr());
+    }
+
+    ssize_t n = read_fd(buffer_.get(), size_);
+    if (n <= 0) {
+      return traits_type::eof();
+    }
+    setg(buffer_.get(), buffer_.get(), buffer_.get() + n);
+    return traits_type::to_int_type(*gptr());
+  }
+
+  std::streamsize xsgetn(char *s, std::streamsize count) override {
+    std::streamsize done = std::min<std::streamsize>(count, egptr() - gptr());
+
+    /* hand out what is buffered already */
+    traits_type::copy(s, gptr(), static_cast<std::size_t>(done));
+    gbump(static_cast<int>(done));
+
+    /* read big chunks directly into the destination */
+    while (count - done >= static_cast<std::streamsize>(size_)) {
+      ssize_t n = read_fd(s + done, static_cast<std::size_t>(count - done));
+      if (n <= 0) {
+        return done;
+      }
+      done += n;
+    }
+
+    /* refill the buffer for the rest */
+    while (done < count && underflow() != traits_type::eof()) {
+      std::streamsize chunk = std::min<std::streamsize>(count - done, egptr() - gptr());
+
+      traits_type::copy(s + done, gptr(), static_cast<std::size_t>(chunk));
+      gbump(static_cast<int>(chunk));
+      done += chunk;
+    }
+    return done;
+  }
+
+  int_type overflow(int_type ch) override {
+    if (!writing_ || flush_buffer(nullptr, 0) == -1) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(ch);
+      pbump(1);
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize count) override {
+    if (!writing_) {
+      return 0;
+    }
+
+    /* small writes go to the buffer */
+    if (count < epptr() - pptr()) {
+      traits_type::copy(pptr(), s, static_cast<std::size_t>(count));
+      pbump(static_cast<int>(count));
+      return count;
+    }
+
+    /* big writes go out together with the buffer in one system call */
+    return flush_buffer(s, static_cast<std::size_t>(count)) == -1 ? 0 : count;
+  }
+
+  int sync() override { return writing_ ? flush_buffer(nullptr, 0) : 0; }
+
+private:
+  ssize_t read_fd(char *s, std::size_t count) {
+    ssize_t n;
+
+    while ((n = ::read(fd_, s, count)) == -1 && errno == EINTR) {
+    }
+    return n;
+  }
+
+  /**
+   * @brief write the buffer followed by count bytes of s to the file descriptor
+   *
+   * @returns 0 on success or -1 in case of error
+   */
+  int flush_buffer(const char *s, std::size_t count) {
+    struct iovec iov[2] = {{pbase(), static_cast<std::size_t>(pptr() - pbase())},
+                           {const_cast<char *>(s), count}};
+    struct iovec *next = iov;
+    int left = 2;
+
+    while (left > 0) {
+      ssize_t n = ::writev(fd_, next, left);
+
+      if (n == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return -1;
+      }
+      for (; left > 0 && static_cast<std::size_t>(n) >= next->iov_len; --left, ++next) {
+        n -= static_cast<ssize_t>(next->iov_len);
+      }
+      if (left > 0) {
+        next->iov_base = static_cast<char *>(next->iov_base) + n;
+        next->iov_len -= static_cast<std::size_t>(n);
+      }
+    }
+    setp(buffer_.get(), buffer_.get() + size_);
+    return 0;
+  }
+
+  int fd_;
+  std::size_t size_;
+  std::unique_ptr<char[]> buffer_;
+  bool writing_;
+};
+
+} // namespace mypp
+
+#endif /* _MYPOPEN_STREAMBUF_HPP_ */
@@ -0,0 +1,171 @@
+#include "mypopen.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * the highest placeholder number accepted
+ */
+#define MAX_PLACEHOLDER 4095
+
+/**
+ * @brief get the number of a placeholder word
+ *
+ * @param word the word, a placeholder if it is {N} with N a decimal number
+ *
+ * @returns the number or -1 if the word is not a placeholder
+ */
+static int placeholder(const char *word) {
+  int number = 0;
+
+  if (*word++ != '{' || *word == '}') {
+    return -1;
+  }
+  for (; *word >= '0' && *word <= '9'; ++word) {
+    if ((number = number * 10 + (*word - '0')) > MAX_PLACEHOLDER) {
+      return -1;
+    }
+  }
+
+  return word[0] == '}' && word[1] == '\0' ? number : -1;
+}
+
+/**
+ * @brief compile a command template into an argument vector
+ *
+ * The template is split into words once, so children can be created from it
+ * without a shell and without building a command string each time. Words are
+ * separated by blanks; single quotes, double quotes and backslashes work like
+ * in the shell, but nothing is expanded. An unquoted word {N} is a
+ * placeholder for argument N given to myptemplate_spawn; placeholders fill
+ * whole words, so only pointers to the arguments are copied per child.
+ *
+ * @param tmpl the template to be initialized, to be freed with myptemplate_destroy
+ * @param pattern the command template, e.g. "grep -c -- {0} {1}"
+ *
+ * @returns 0 on success or -1 in case of error (errno is EINVAL if the
+ *          template is empty or has an unterminated quote)
+ */
+int myptemplate_compile(struct myptemplate *tmpl, const char *pattern) {
+  size_t length = strlen(pattern);
+  const char *p = pattern;
+  char *out;
+
+  memset(tmpl, 0, sizeof(*tmpl));
+
+  /* a word takes at least one character and a separator, unless it is the last one */
+  if ((tmpl->arena = malloc(length + 1)) == NULL ||
+      (tmpl->argv = malloc((length / 2 + 2) * sizeof(*tmpl->argv))) == NULL ||
+      (tmpl->slots = malloc((length / 2 + 2) * sizeof(*tmpl->slots))) == NULL) {
+    /* errno is set by malloc */
+    myptemplate_destroy(tmpl);
+    return -1;
+  }
+  out = tmpl->arena;
+
+  for (;;) {
+    char *word = out;
+    int quoted = 0;
+    char quote = '\0';
+
+    while (*p == ' ' || *p == '\t' || *p == '\n') {
+      ++p;
+    }
+    if (*p == '\0') {
+      break;
+    }
+
+    for (; *p != '\0' && (quote != '\0' || (*p != ' ' && *p != '\t' && *p != '\n')); ++p) {
+      if (quote == '\0' && (*p == '\'' || *p == '"')) {
+        quote = *p;
+        quoted = 1;
+      } else if (quote != '\0' && *p == quote) {
+        quote = '\0';
+      } else if (*p == '\\' && quote != '\'' && p[1] != '\0' &&
+                 (quote == '\0' || p[1] == '"' || p[1] == '\\')) {
+        /* inside double quotes only a quote or backslash is escaped, like in the shell */
+        *out++ = *++p;
+        quoted = 1;
+      } else {
+        *out++ = *p;
+      }
+    }
+    if (quote != '\0') {
+      myptemplate_destroy(tmpl);
+      errno = EINVAL;
+      return -1;
+    }
+    *out++ = '\0';
+
+    tmpl->slots[tmpl->argc] = quoted ? -1 : placeholder(word);
+    if (tmpl->slots[tmpl->argc] != -1) {
+      if ((size_t)tmpl->slots[tmpl->argc] >= tmpl->nargs) {
+        tmpl->nargs = (size_t)tmpl->slots[tmpl->argc] + 1;
+      }
+      tmpl->argv[tmpl->argc++] = NULL;
+    } else {
+      tmpl->argv[tmpl->argc++] = word;
+    }
+  }
+
+  if (tmpl->argc == 0) {
+    myptemplate_destroy(tmpl);
+    errno = EINVAL;
+    return -1;
+  }
+  tmpl->argv[tmpl->argc] = NULL;
+
+  return 0;
+}
+
+/**
+ * @brief create a child from a template like mypspawn does with attr->argv
+ *
+ * The first word is the program, searched in PATH if it contains no slash.
+ * The template is not changed, so it can be used by several threads at once.
+ *
+ * @param tmpl the compiled template
+ * @param args the arguments for the placeholders, at least tmpl->nargs of them
+ * @param type "r" for reading from the child or "w" for writing to it
+ * @param attr further options for the child process (may be NULL, its argv is ignored)
+ * @param fd where to store the file descriptor of the pipe
+ *
+ * @returns the process id of the child or -1 in case of error
+ */
+pid_t myptemplate_spawn(const struct myptemplate *tmpl, const char *const *args, const char *type,
+                        const struct mypopen_attr *attr, int *fd) {
+  struct mypopen_attr spawn_attr;
+  char *argv[tmpl->argc + 1];
+  size_t i;
+
+  if (tmpl->argv == NULL || (args == NULL && tmpl->nargs > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (i = 0; i < tmpl->argc; ++i) {
+    argv[i] = tmpl->slots[i] != -1 ? (char *)args[tmpl->slots[i]] : tmpl->argv[i];
+  }
+  argv[tmpl->argc] = NULL;
+
+  if (attr != NULL) {
+    spawn_attr = *attr;
+  } else {
+    mypopen_attr_init(&spawn_attr);
+  }
+  spawn_attr.argv = argv;
+
+  return mypspawn(argv[0], type, &spawn_attr, fd);
+}
+
+/**
+ * @brief free the memory of a template
+ *
+ * @param tmpl the template
+ */
+void myptemplate_destroy(struct myptemplate *tmpl) {
+  free(tmpl->arena);
+  free(tmpl->argv);
+  free(tmpl->slots);
+  memset(tmpl, 0, sizeof(*tmpl));
+}
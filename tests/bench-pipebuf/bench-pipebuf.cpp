@@ -0,0 +1,104 @@
+/**
+ * @file bench-pipebuf.cpp
+ * Compare reading the output of a child process with fgets() against
+ * reading it through mypp::pipebuf.
+ *
+ * Usage: bench-pipebuf [<megabytes>] [<buffer size>]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
+#include <string>
+
+#include "../../src/mypopen.hpp"
+#include "../../src/mypopen_streambuf.hpp"
+
+#define LINELEN 256
+
+static std::size_t megabytes = 256;
+static std::size_t buffer_size = mypp::pipebuf::default_size;
+
+/**
+ * @brief run a reader on the output of the benchmark command and report its throughput
+ */
+template <typename Reader> static void bench(const char *name, Reader reader) {
+  char command[128];
+  std::size_t bytes;
+
+  snprintf(command, sizeof(command), "yes 'a line of text written by the child process' | head -c %zuM",
+           megabytes);
+
+  auto start = std::chrono::steady_clock::now();
+  auto process = mypp::Process::open(command, "r");
+  if (!process) {
+    perror("mypopen");
+    exit(EXIT_FAILURE);
+  }
+  bytes = reader(process.stream());
+  if (process.wait() != 0) {
+    fprintf(stderr, "%s: command failed\n", name);
+    exit(EXIT_FAILURE);
+  }
+  std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+  printf("%-20s %10zu bytes %8.3f s %10.1f MiB/s\n", name, bytes, seconds.count(),
+         bytes / seconds.count() / (1024 * 1024));
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    megabytes = strtoul(argv[1], nullptr, 0);
+  }
+  if (argc > 2) {
+    buffer_size = strtoul(argv[2], nullptr, 0);
+  }
+
+  bench("fgets", [](FILE *stream) {
+    char line[LINELEN];
+    std::size_t bytes = 0;
+
+    while (fgets(line, sizeof(line), stream) != nullptr) {
+      bytes += strlen(line);
+    }
+    return bytes;
+  });
+
+  bench("pipebuf getline", [](FILE *stream) {
+    mypp::pipebuf buf(stream, buffer_size);
+    std::istream in(&buf);
+    std::string line;
+    std::size_t bytes = 0;
+
+    while (std::getline(in, line)) {
+      bytes += line.size() + (in.eof() ? 0 : 1);
+    }
+    return bytes;
+  });
+
+  bench("fread", [](FILE *stream) {
+    static char block[1024 * 1024];
+    std::size_t bytes = 0, n;
+
+    while ((n = fread(block, 1, sizeof(block), stream)) > 0) {
+      bytes += n;
+    }
+    return bytes;
+  });
+
+  bench("pipebuf read", [](FILE *stream) {
+    static char block[1024 * 1024];
+    mypp::pipebuf buf(stream, buffer_size);
+    std::istream in(&buf);
+    std::size_t bytes = 0;
+
+    while (in.read(block, sizeof(block)) || in.gcount() > 0) {
+      bytes += static_cast<std::size_t>(in.gcount());
+    }
+    return bytes;
+  });
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file bench-spawn.c
+ * Count the heap allocations and measure the time per child for the ways
+ * of running a short command and reading its output.
+ *
+ * Usage: bench-spawn [<children>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../src/mypopen.h"
+
+#define COMMAND "echo a line of output"
+
+/* the allocator of glibc behind malloc, calloc, realloc and free */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *block, size_t size);
+extern void __libc_free(void *block);
+
+static size_t allocations = 0;
+static unsigned long children = 2000;
+
+/* count every allocation of the process, including the ones of stdio */
+void *malloc(size_t size) {
+  ++allocations;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  ++allocations;
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *block, size_t size) {
+  ++allocations;
+  return __libc_realloc(block, size);
+}
+
+void free(void *block) { __libc_free(block); }
+
+/**
+ * @brief run a child the given way over and over and report the cost per child
+ */
+static void bench(const char *name, int (*run)(void)) {
+  struct timespec start, end;
+  size_t start_allocations;
+  unsigned long i;
+
+  /* the first children fill the caches */
+  for (i = 0; i < 10; ++i) {
+    if (run() == -1) {
+      perror(name);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  start_allocations = allocations;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < children; ++i) {
+    if (run() == -1) {
+      perror(name);
+      exit(EXIT_FAILURE);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  printf("%-20s %8.2f allocations %8.1f us per child\n", name,
+         (double)(allocations - start_allocations) / children,
+         ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3) / children);
+}
+
+static int run_fgets(void) {
+  char line[256];
+  FILE *stream;
+
+  if ((stream = mypopen(COMMAND, "r")) == NULL) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), stream) != NULL) {
+  }
+  return mypclose(stream);
+}
+
+static int run_drain(void) {
+  struct mypdrain_stats stats;
+  FILE *stream;
+
+  if ((stream = mypopen(COMMAND, "r")) == NULL) {
+    return -1;
+  }
+  if (mypdrain(stream, &stats) == -1) {
+    mypclose(stream);
+    return -1;
+  }
+  return mypclose(stream);
+}
+
+static int run_lines(void) {
+  struct mypline_reader reader;
+  const char *line;
+  pid_t child;
+  int fd;
+
+  if ((child = mypspawn(COMMAND, "r", NULL, &fd)) == -1) {
+    return -1;
+  }
+  if (mypline_init(&reader, fd, 0) == 0) {
+    while (mypline_next(&reader, &line) > 0) {
+    }
+    mypline_destroy(&reader);
+  }
+  close(fd);
+  return waitpid(child, NULL, 0) == child ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    children = strtoul(argv[1], NULL, 0);
+  }
+  if (children == 0) {
+    children = 1;
+  }
+
+  bench("mypopen fgets", run_fgets);
+  bench("mypopen mypdrain", run_drain);
+  bench("mypspawn mypline", run_lines);
+
+  return EXIT_SUCCESS;
+}
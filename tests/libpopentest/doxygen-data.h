@@ -20,3 +20,27 @@
 #define MEMBERDEF_mypopentest18 "Call mypopen() with mode set to writing. Verify that stdin, stdout, stderr, and the read end of the pipe are the only open file descriptors after the mypopen() call. Call mypclose(). Verify that stdin, stdout, and stderr are the only open file descriptors after the mypclose() call (i.e., verify that the read end of the pipe has been properly closed). Additionally verify that mypopen() does not return for the created child process, but properly invokes exit(3) in the child process."
 #define MEMBERDEF_mypopentest19 "Check whether mypclose() behaves properly (i.e., returns -1 and sets errno to ECHLD) if waitpid() fails for reasons different from EINTR. Additionally verify that mypopen() does not return for the created child process, but properly invokes exit(3) in the child process."
 #define MEMBERDEF_mypopentest20 "Do a mypopen() with a really long commandline that causes execl() to fail and set errno to E2BIG. - Check whether mypopen() is successful anyway (i.e., returns something != NULL). Additionally verify that mypopen() does not return for the created child process, but properly invokes exit(3) in the child process."
+#define MEMBERDEF_mypopentest21 "Enable the output cache, call mypopen() with a command writing more than fits in a pipe, read only the first line and call mypclose(). - Call mypopen() with the same command again. - The command must not be run again, the stream must have a file descriptor that polls readable and the whole output must be read."
+#define MEMBERDEF_mypopentest22 "Enable the output cache with the working directory as part of the key. - Read the output of a command twice, the second time from another working directory, and a different command. - Every one of them must be a miss that runs its command and gets its own output."
+#define MEMBERDEF_mypopentest23 "Enable the output cache with a lifetime of 200 ms and read the output of a command. - Reading it again right away must not run the command, reading it once the lifetime has passed must run it again."
+#define MEMBERDEF_mypopentest24 "Enable the output cache and read the output of a command exiting with status 42 twice. - The output must not be cached, so the command runs both times and mypclose() returns 42 both times."
+#define MEMBERDEF_mypopentest25 "Call mypopen(\"sleep 5\", \"w\") and write more than fits in the pipe, so data stays buffered. - mypclose_timeout() with a deadline of 100 ms must not block on flushing the data, but return -1 with errno set to ETIMEDOUT well before the child would exit, with the child terminated by SIGTERM. - Data the child reads in time must still be flushed."
+#define MEMBERDEF_mypopentest26 "Call mypopen() with a command ignoring SIGTERM and close it with mypclose_timeout() after 100 ms, escalating to SIGTERM with a grace period of 200 ms and then to SIGKILL. - mypclose_timeout() must return -1 with errno set to ETIMEDOUT after about 300 ms with the child killed by SIGKILL."
+#define MEMBERDEF_mypopentest27 "Call mypclose_abort() on a running child, on a child blocked with a full pipe and data still buffered, and on a child that has already exited with status 42. - The first two must return -1 right away with errno set to ECANCELED and the child killed by SIGKILL, the last one must return 42."
+#define MEMBERDEF_mypopentest28 "Call mypopen_ex() with MYPOPEN_SETPGRP and a shell that starts a background grandchild. - mypkill() must signal the whole process group, so the grandchild terminates as well. - Do the same with a grandchild ignoring SIGTERM and mypclose_timeout(): once the close had to escalate, whatever is left of the group must be killed."
+#define MEMBERDEF_mypopentest29 "Call mypopen_ex() with MYPOPEN_SUBREAPER and a shell that exits while a background grandchild keeps running. - mypclose() must return the exit status of the shell, and the grandchild must have been killed and reaped by the caller, so no process is left behind."
+#define MEMBERDEF_mypopentest30 "Check the counters of mypstats_snapshot(): a child of mypopen() counts as spawned and active, as a zombie once it has exited and as active no more after mypclose(); the bytes read with mypdrain() and given as stdin_data are counted; a missing program counts as a spawn failure with ENOENT; a close that has to escalate counts as a close timeout; and a mypopen() failing in fdopen() leaves no active child behind."
+#define MEMBERDEF_mypopentest31 "Build an environment with mypenv_init() from two variables, replace one, add one and remove one, and check mypenv_get() and the array of mypenv_envp(), which has to be rebuilt after every change and must be what a child created with it sees. - Replace a large variable often enough to fill the arena many times, which must be compacted instead of grown. - Let the second malloc() of mypenv_init() fail, after which mypenv_destroy() must still be safe."
+#define MEMBERDEF_mypopentest32 "Create a cgroup below the one of the test and call mypopen_ex() with it as cgroup; the child must find itself in that cgroup in /proc/self/cgroup. - Call mypopen_ex() with a cgroup that does not exist, which has to fail with ENOENT. The test is skipped if no cgroup2 file system is mounted or the cgroup cannot be created (not delegated)."
+#define MEMBERDEF_mypopentest33 "Enable the output cache in memory and in a directory and read the output of a command larger than a pipe with read() on its file descriptor, 7 bytes at a time. - Read it again from the memory and, with only the directory enabled, from the directory, once with read() of 7 bytes and once with fread() of 1 byte. - Every replay must return exactly the bytes of the command, which must have run once only."
+#define MEMBERDEF_mypopentest34 "Run a program by name without a shell with PATH set to an empty directory, which has to fail with ENOENT in the parent. - Install the program but restore the mtime of the directory: the failed lookup is cached for that state of the directory, so it must still fail. - Change the mtime, the program must be found now. - Replace the program with another file, which must be run instead of the cached one. - Set PATH to another directory holding another program of the same name, which must be run."
+#define MEMBERDEF_mypopentest35 "Check the XXH64 hash (seed 0) of mypdrain() against the reference values for the empty input, 1 byte and 43 bytes. - Read lines of every length from 1 to 71 bytes and a last line without newline from a file with mypline_next() and a buffer of 333 bytes, so the lines start at every alignment: every line must be returned as written. - Count the newlines of prefixes of odd lengths of the file with mypdrain(), which must match a count one byte at a time. The vector scanners hand their tails to the narrower ones, so this covers AVX2, SSE2 and scalar code."
+#define MEMBERDEF_mypopentest36 "Call mypbatch() with a slow, a failing, a missing (NULL) and another command. - The results must be stored in the order of the commands, with the output and exit status of each and a wstatus of -1 and EINVAL for the command that could not be started, while the callback sees them as they complete. - Run six commands logging their start and end with a concurrency of two: no more than two must run at the same time."
+#define MEMBERDEF_mypopentest37 "Call mypcapture() for output larger than a pipe, which must be captured completely, and for a command without output. - Capture a command exiting with 5 and one killed by a signal, whose output must be available as well, with 5 returned and -1 and ECHILD respectively. - Capture while a stream of mypopen() is open, which must not be affected. - mypcapture_free() must leave an empty output behind."
+#define MEMBERDEF_mypopentest38 "Call mypopen_ex() with 200000 bytes of stdin_data and \"wc -c\", which must count all of them, and with empty stdin_data, which must count none. - Let the child try to overwrite its standard input before reading it: the data is sealed, so the child must read it unchanged. - Call mypcapture() with stdin_data and \"tr a-z A-Z\"."
+#define MEMBERDEF_mypopentest39 "Call mypopen_ex() with a temporary directory as cwd and \"pwd -P\", which must print it while the working directory of the caller stays the same, and with a cwd that does not exist, which must let the child exit with 1. - Run printf with argv holding spaces and shell syntax, which must reach the program unchanged. - Run \"./program\" with the temporary directory as cwd, which must be found relative to it."
+#define MEMBERDEF_mypopentest40 "Compile a template with quoted words, an escaped blank, a quoted placeholder and two placeholders with myptemplate_compile() and create two children from it with myptemplate_spawn() and different arguments: each must get its arguments as whole words, quotes removed and nothing expanded. - A placeholder may be the program. - An empty template, an unterminated quote, missing arguments and a destroyed template must fail with EINVAL."
+#define MEMBERDEF_mypopentest41 "Call mypopen_ex() with MYPOPEN_SETNICE and a nice value of 5, which \"nice\" in the child must print, and with MYPOPEN_SETSCHED and SCHED_BATCH, which must be the policy in /proc/self/stat of the child, both together as well. - Restrict the child to CPU 0 with cpus, which must be its Cpus_allowed_list. - A policy that cannot be set (SCHED_FIFO with priority 0) must let the child exit with 1. - The caller must keep its nice value and policy."
+#define MEMBERDEF_mypopentest42 "Call mypopen_ex() with limits on open files (64 soft, 128 hard) and on core files (0), which must show up in /proc/self/limits of the child and be what \"ulimit -n\" prints. - A soft limit above the hard one must let the child exit with 1. - The limits of the caller must stay the same."
+#define MEMBERDEF_mypopentest43 "Call mypopen_ex() with MYPOPEN_SETIOPRIO and the best-effort class at level 6, which \"ionice -p $$\" in the child must print, and with the idle class. - A class or level out of range must let the child exit with 1. - The I/O priority of the caller must stay the same."
+#define MEMBERDEF_mypopentest44 "Count the allocations of the size of a stream buffer while calling mypopen(), fgets() and mypclose() 10 times: only the first stream may allocate its buffer, the others must reuse it. - Read a line of 10001 bytes with mypline_next() and a buffer of 4096 bytes, which grows the buffer to 16384 bytes, and then initialize a reader with 16384 bytes: the grown buffer must be reused and return the next line unchanged."
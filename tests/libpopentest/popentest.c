@@ -22,8 +22,8 @@
  *
  * This library called \c libpopentest.a provides an automated test
  * suite for the \c mypopen()/mypclose() module. The library
- * implements 17 tests named \a mypopentest00() (Test 00) to \a
- * mypopentest20() (Test 21) and provides a \a main() function that
+ * implements 45 tests named \a mypopentest00() (Test 00) to \a
+ * mypopentest44() (Test 44) and provides a \a main() function that
  * calls these tests in sequence.
  *
  * In case only some of the tests shall be executed a list of tests
@@ -33,6 +33,16 @@
  *
 \verbatim
 ./popentest 1 3 5 7
+\endverbatim
+ *
+ * The tests are independent of each other (each one runs in its own
+ * child process), so they can also be executed concurrently by passing
+ * the maximum number of tests to run at the same time with \c -j. - The
+ * output of each test is collected and printed as a whole in the order
+ * the tests were requested, followed by the wall time the test took:
+ *
+\verbatim
+./popentest -j 8
 \endverbatim
  *
  * The library assumes that your versions of \c popen()/\c pclose() are
@@ -78,6 +88,8 @@
  * -------------------------------------------------------------- includes --
  */
 
+#define _GNU_SOURCE /* SCHED_BATCH, cpu_set_t */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -91,12 +103,18 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/stat.h>
+#include <sched.h>
 #include <sys/wait.h>
 #include <malloc.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <time.h>
 #include <getopt.h>
+#include <dirent.h>
 
 #include "utils.h"
-#include "mypopen.h"
+#include "../../src/mypopen.h"
 
 #include "doxygen-data.h"
 
@@ -126,6 +144,9 @@ static const char *emph_off     = "\033[0m";
 
 #define REALLY_LONG_COMMAND_LENGTH 131072UL
 
+#define JOB_POLL_TIMEOUT_MS 50
+#define JOB_READ_CHUNK 4096
+
 #define FAIL_AND_EXIT(type)                 		\
     do {						\
         printfail(testname, testdescription, __LINE__, type);   \
@@ -157,6 +178,13 @@ static const char *emph_off     = "\033[0m";
 #define __MALLOC_HOOK_VOLATILE
 #endif
 
+/* glibc 2.34 removed __malloc_hook - interpose malloc() directly instead */
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+#define HAVE_MALLOC_HOOK 0
+#else
+#define HAVE_MALLOC_HOOK 1
+#endif
+
 /*
  * -------------------------------------------------------------- typedefs --
  */
@@ -175,12 +203,32 @@ struct test {
     const char * const testfunc_desc;
 };
 
+struct output {
+    char *data;
+    size_t len;
+    size_t size;
+};
+
+struct job {
+    const struct test *test;
+    pid_t pid;
+    int fd[2];                  /* read ends collecting stdout and stderr of the test */
+    struct output out[2];
+    struct timespec start;
+    struct timespec end;
+    int done;
+};
+
 /*
  * ------------------------------------------------------------ prototypes --
  */
 
+#if HAVE_MALLOC_HOOK
 static void my_malloc_init_hook(void);
 static void *my_malloc_hook(size_t, const void *);
+#else
+extern void *__libc_malloc(size_t);
+#endif
 
 /*
  * --------------------------------------------------------------- globals --
@@ -204,11 +252,16 @@ static volatile FILE **fptoclose = NULL;
 static const char dummybuffer[1024 * 65]; /* 64 K Pipe Buffer */
 
 static volatile int let_malloc_fail = 0;
+static volatile int mallocs_before_failure = 0; /* succeed this often before failing */
+static volatile size_t counted_size = 0; /* the size of the allocations counted */
+static volatile int counted_mallocs = 0; /* the number of allocations of counted_size */
 
 static int print_description = 0;
 
+#if HAVE_MALLOC_HOOK
 static void *(*old_malloc_hook)(size_t, const void *); /* to save original malloc hook */
 void (*__MALLOC_HOOK_VOLATILE __malloc_initialize_hook) (void) = my_malloc_init_hook; /* override malloc init hook */
+#endif
 
 /*
  * ------------------------------------------------------------- functions --
@@ -223,6 +276,7 @@ static void setTestName(
     testdescription = description;
 }
 
+#if HAVE_MALLOC_HOOK
 static void my_malloc_init_hook(
     void
     )
@@ -251,7 +305,12 @@ static void *my_malloc_hook(
 
     (void)caller;
 
-    if (let_malloc_fail)
+    if (size == counted_size)
+    {
+	++counted_mallocs;
+    }
+
+    if (let_malloc_fail && mallocs_before_failure-- <= 0)
     {
 	TRACE("Letting malloc() fail by returning with NULL ...\n");
 
@@ -288,6 +347,29 @@ static void *my_malloc_hook(
     return result;
 }
 
+#else
+/*
+ * the malloc() interposer takes no locks and calls no tracing functions,
+ * since both might end up in malloc() again
+ */
+void *malloc(
+    const size_t size
+    )
+{
+    if (size == counted_size)
+    {
+	++counted_mallocs;
+    }
+
+    if (let_malloc_fail && mallocs_before_failure-- <= 0)
+    {
+	return NULL;
+    }
+
+    return __libc_malloc(size);
+}
+#endif
+
 /**
  * \brief Print usage message
  *
@@ -304,7 +386,7 @@ static void usage(
 
     (void) fprintf(
         stderr,
-        "USAGE: %s [-v|--verbose] [-d|--description] [[-c|--color] [auto|never|always]] [<num1>] [<num2>] ...\n",
+        "USAGE: %s [-v|--verbose] [-d|--description] [[-c|--color] [auto|never|always]] [[-j|--jobs] <n>] [<num1>] [<num2>] ...\n",
         cmd
         );
 
@@ -572,268 +654,3434 @@ static FILE *mycheckedpopen(
 }
 
 /**
- * \brief Spawn a child process
- *
- * This function spawns a child process executing the function \a func
- * with the name \a funcname. - Afterwards the function waits for the proper
- * termination of the child process.
- *
- * \param test pointer to the test description
+ * \brief Count the lines of a file
  *
- * \return nothing
+ * \param path name of the file
  *
+ * \return number of lines in the file (0 if it cannot be opened)
  */
-static void spawn(const struct test * const test)
+static int countlines(
+    const char * const path
+    )
 {
-    pid_t pid;
-    int status = 0;
-    const pid_t childpid = fork();
-    switch (childpid)
-    {
-    case -1:
-        bailout("Cannot create child process for executing %s()", test->testfunc_name);
-        break;
-        
-    case 0:
-        TRACE("Child process %d is executing %s() ...\n", getpid(), test->testfunc_name);
-
-        test->testfunc(test->testfunc_name, test->testfunc_desc);
-
-        exit(EXIT_SUCCESS);
-        break;
-
-    default:
-        TRACE("Spawned child process %d executing %s() ...\n", childpid, test->testfunc_name);
+    FILE *file;
+    int lines = 0;
+    int c;
 
-        while ((pid = waitpid(childpid, &status, 0)) != childpid)
-        {
-            if ((pid == -1) && (errno != EINTR))
-            {
-                bailout("Cannot wait child process %d executing %s()", childpid, test->testfunc_name);
-            }
-        }
+    if ((file = fopen(path, "r")) == NULL)
+    {
+        return 0;
+    }
 
-        if (WIFEXITED(status))
-        {
-            TRACE(
-                "Child process %d executing %s() terminated with status %d ...\n",
-                childpid,
-                test->testfunc_name,
-                WEXITSTATUS(status)
-                );
-        }
-        else
+    while ((c = fgetc(file)) != EOF)
+    {
+        if (c == '\n')
         {
-            TRACE("Child process %d executing %s() terminated abnormally ...\n", childpid, test->testfunc_name);
+            ++lines;
         }
-        break;
     }
+
+    (void) fclose(file);
+
+    return lines;
 }
 
 /**
- * \brief Test 00
+ * \brief Read the whole output of a command with mypopen()
  *
- * Try to call mypclose() prior to mypopen() - This should yield an error
- * and errno should be set to ECHILD
+ * \param command command to be executed
+ * \param lines where to store the number of lines read
  *
- * \return Nothing
+ * \return the result of mypclose() or -2 if mypopen() fails
  */
-void mypopentest00(
-    const char * const testname, 
-    const char * const testdescription
+static int readcommand(
+    const char * const command,
+    int * const lines
     )
 {
-    ENTER();
-
-    setTestName(testname, testdescription);
+    char buffer[MAXLINE];
 
-    initresources();
+    *lines = 0;
 
-    /*
-     * take caution here, since this might hang if passed a bogus file
-     * pointer (i.e., one not obtained via popen())
-     */
-    (void) alarm(5);
+    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
+    {
+        return -2;
+    }
 
-    TRACE0("Trying mypclose(bogusreadfp) ...\n");
+    while (fgets(buffer, sizeof(buffer), fp[0]) != NULL)
+    {
+        ++*lines;
+    }
 
-    errno = 0;
+    return mypclose(fp[0]);
+}
 
-    if ((mypclose(bogusreadfp) != -1) || (errno != ECHILD))
+/**
+ * \brief Build a command counting its runs in a file
+ *
+ * \param command where to store the command
+ * \param size size of \a command
+ * \param counter the file that gets a line per run
+ * \param rest the command run after counting
+ */
+static void countedcommand(
+    char * const command,
+    const size_t size,
+    const char * const counter,
+    const char * const rest
+    )
+{
+    if ((size_t) snprintf(command, size, "echo run >> %s; %s", counter, rest) >= size)
     {
-        bogusreadfp = NULL; /* mypclose has closed this one */
-        alarmoccurred = 0;
-
-        FAIL(MANDATORY);
+        errno = 0;
+        bailout("Command too long");
     }
+}
 
-    if (alarmoccurred == 1)
-    {
-        bogusreadfp = NULL; /* mypclose has closed this one */
-        alarmoccurred = 0;
+/**
+ * \brief Get the milliseconds passed since a point in time
+ *
+ * \param start the point in time (CLOCK_MONOTONIC)
+ *
+ * \return the milliseconds passed since \a start
+ */
+static long elapsedms(
+    const struct timespec * const start
+    )
+{
+    struct timespec now;
 
-        FAIL(MANDATORY);
-    }
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
 
-    /*
-     * take caution here, since this might hang if passed a bogus file
-     * pointer (i.e., one not obtained via popen())
-     */
-    (void) alarm(5);
+    return (now.tv_sec - start->tv_sec) * 1000L + (now.tv_nsec - start->tv_nsec) / 1000000L;
+}
 
-    TRACE0("Trying mypclose(boguswritefp) ...\n");
+/**
+ * \brief Wait for a process to terminate
+ *
+ * A zombie counts as terminated, since orphans are not necessarily
+ * reaped right away.
+ *
+ * \param pid the process
+ * \param timeoutms the time to wait in milliseconds
+ *
+ * \return 1 if the process has terminated, 0 otherwise
+ */
+static int waitgone(
+    const pid_t pid,
+    const long timeoutms
+    )
+{
+    const struct timespec delay = { 0, 10 * 1000 * 1000L };
+    struct timespec start;
+    char path[64];
+    char line[MAXLINE];
 
-    errno = 0;
+    (void) clock_gettime(CLOCK_MONOTONIC, &start);
 
-    if ((mypclose(boguswritefp) != -1)  || (errno != ECHILD))
+    for (;;)
     {
-        boguswritefp = NULL; /* mypclose has closed this one */
-        alarmoccurred = 0;
+        FILE *file;
+        char *state;
 
-        FAIL(MANDATORY);
-    }
+        if (kill(pid, 0) == -1 && errno == ESRCH)
+        {
+            return 1;
+        }
 
-    if (alarmoccurred == 1)
-    {
-        boguswritefp = NULL; /* mypclose has closed this one */
-        alarmoccurred = 0;
+        (void) snprintf(path, sizeof(path), "/proc/%ld/stat", (long) pid);
 
-        FAIL(MANDATORY);
+        if ((file = fopen(path, "r")) == NULL)
+        {
+            return 1;
+        }
 
-    }
+        state = fgets(line, sizeof(line), file) != NULL ? strrchr(line, ')') : NULL;
 
-    freeresources();
+        (void) fclose(file);
 
-    PASS();
+        if (state != NULL && (state[2] == 'Z' || state[2] == 'X'))
+        {
+            return 1;
+        }
 
-    EXIT();
+        if (elapsedms(&start) >= timeoutms)
+        {
+            return 0;
+        }
+
+        (void) nanosleep(&delay, NULL);
+    }
 }
 
 /**
- * \brief Test 01
+ * \brief Open a command with mypopen_ex() and read the process id it prints
  *
- * Try to call mypopen() twice (without an intermediate mypclose()) -
- * This should yield an error and errno should be set to EAGAIN.
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * \param command the command, printing a process id on its first line
+ * \param flags the MYPOPEN_* flags for the child
+ * \param grandchild where to store the process id read
  *
- * \return Nothing
+ * \return 0 on success, -1 otherwise (fp[0] is set if the stream was opened)
  */
-void mypopentest01(
-    const char * const testname, 
-    const char * const testdescription
+static int openwithgrandchild(
+    const char * const command,
+    const unsigned int flags,
+    pid_t * const grandchild
     )
 {
-    ENTER();
+    struct mypopen_attr attr;
+    char buffer[MAXLINE];
 
-    setTestName(testname, testdescription);
+    mypopen_attr_init(&attr);
+    attr.flags = flags;
 
-    initresources();
+    if ((fp[0] = mypopen_ex(command, "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL)
+    {
+        return -1;
+    }
 
-    TRACE0("Trying mypopen(\"date 2> /dev/null\", \"r\") ...\n");
+    *grandchild = (pid_t) strtol(buffer, NULL, 10);
 
-    if ((fp[0] = MYCHECKEDPOPEN("date 2> /dev/null", "r")) == NULL)
+    return *grandchild > 0 ? 0 : -1;
+}
+
+/**
+ * \brief Find the cgroup v2 directory of the calling process
+ *
+ * \param path where to store the directory
+ * \param size size of path
+ *
+ * \return 0 on success or -1 if no cgroup2 file system is mounted
+ */
+static int owncgroup(
+    char * const path,
+    const size_t size
+    )
+{
+    char line[PATH_MAX * 2];
+    char mountpoint[PATH_MAX] = "";
+    char group[PATH_MAX] = "";
+    char root[PATH_MAX];
+    char fstype[64];
+    char *separator;
+    FILE *file;
+    size_t rootlength;
+
+    if ((file = fopen("/proc/self/mountinfo", "r")) == NULL)
     {
-        FAIL(MANDATORY);
+        return -1;
     }
 
-    TRACE0("Trying mypopen(\"ls 2> /dev/null\", \"r\") ...\n");
+    while (mountpoint[0] == '\0' && fgets(line, sizeof(line), file) != NULL)
+    {
+        /* the file system type follows the separator of the optional fields */
+        if ((separator = strstr(line, " - ")) != NULL &&
+            sscanf(separator, " - %63s", fstype) == 1 && strcmp(fstype, "cgroup2") == 0 &&
+            sscanf(line, "%*s %*s %*s %4095s %4095s", root, mountpoint) != 2)
+        {
+            mountpoint[0] = '\0';
+        }
+    }
 
-    errno = 0;
+    (void) fclose(file);
 
-    if (((fp[1] = MYCHECKEDPOPEN("ls 2> /dev/null", "r")) != NULL) || (errno != EAGAIN))
+    if (mountpoint[0] == '\0' || (file = fopen("/proc/self/cgroup", "r")) == NULL)
     {
-        FAIL(MANDATORY);
+        return -1;
     }
 
-    TRACE0("Trying mypclose(fp[0]) ...\n");
-
-    /*
-     *  call mypclose() in a checked way, since it might fail
-     */
-    if (mypclose(fp[0]) == -1)
+    while (group[0] == '\0' && fgets(line, sizeof(line), file) != NULL)
     {
-        fp[0] = NULL;
-        FAIL(MANDATORY);
+        if (sscanf(line, "0::%4095s", group) != 1)
+        {
+            group[0] = '\0';
+        }
     }
 
-    fp[0] = NULL;
+    (void) fclose(file);
 
-    freeresources();
+    /* the mount may show a subtree of the hierarchy only */
+    rootlength = strcmp(root, "/") == 0 ? 0 : strlen(root);
 
-    PASS();
+    if (group[0] == '\0' || strncmp(group, root, rootlength) != 0 ||
+        snprintf(path, size, "%s%s", mountpoint,
+                 strcmp(group + rootlength, "/") == 0 ? "" : group + rootlength) >= (int) size)
+    {
+        return -1;
+    }
 
-    EXIT();
+    return 0;
 }
 
 /**
- * \brief Test 02
+ * \brief Read a stream to its end in small pieces
  *
- * Try to call mypclose() with a bogus file pointer (i.e., one that
- * has not been obtained via mypopen(). - This should yield an error
- * and errno should be set to EINVAL.
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * \param stream stream to be read
+ * \param buffer where to store what has been read
+ * \param size size of buffer
+ * \param piece bytes per read() on the file descriptor or 0 to read a
+ *        byte at a time with fread()
  *
- * \return Nothing
+ * \return number of bytes read or -1 in case of error or if buffer is too small
  */
-void mypopentest02(
-    const char * const testname, 
-    const char * const testdescription
+static ssize_t readinpieces(
+    FILE * const stream,
+    char * const buffer,
+    const size_t size,
+    const size_t piece
     )
 {
-    ENTER();
+    size_t done = 0;
+    ssize_t n;
 
-    setTestName(testname, testdescription);
+    do
+    {
+        if (done + (piece == 0 ? 1 : piece) > size)
+        {
+            return -1;
+        }
 
-    initresources();
+        if (piece == 0)
+        {
+            n = (ssize_t) fread(buffer + done, 1, 1, stream);
 
-    TRACE0("Trying mypopen(\"cat\", \"w\") ...\n");
+            if (n == 0 && ferror(stream))
+            {
+                return -1;
+            }
+        }
+        else if ((n = read(fileno(stream), buffer + done, piece)) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
 
-    if ((fp[0] = MYCHECKEDPOPEN("cat", "w")) == NULL)
-    {
-        FAIL(MANDATORY);
-    }
+            return -1;
+        }
 
-    /*
+        done += (size_t) n;
+    } while (n > 0);
+
+    return (ssize_t) done;
+}
+
+/**
+ * \brief Remove a directory and the files in it
+ *
+ * \param path name of the directory
+ */
+static void removedirectory(
+    const char * const path
+    )
+{
+    char file[PATH_MAX];
+    struct dirent *entry;
+    DIR *dir;
+
+    if ((dir = opendir(path)) == NULL)
+    {
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+        {
+            (void) snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+            (void) unlink(file);
+        }
+    }
+
+    (void) closedir(dir);
+    (void) rmdir(path);
+}
+
+/**
+ * \brief Install a shell script printing a word as a program
+ *
+ * The script is written under a temporary name and renamed into place,
+ * so an existing program is replaced by a new file.
+ *
+ * \param directory directory to install the program in
+ * \param name name of the program
+ * \param word word printed by the program
+ *
+ * \return 0 on success or -1 in case of error
+ */
+static int writeprogram(
+    const char * const directory,
+    const char * const name,
+    const char * const word
+    )
+{
+    char path[PATH_MAX];
+    char temporary[PATH_MAX];
+    FILE *file;
+    int fd;
+
+    (void) snprintf(path, sizeof(path), "%s/%s", directory, name);
+    (void) snprintf(temporary, sizeof(temporary), "%s/.%s.XXXXXX", directory, name);
+
+    if ((fd = mkstemp(temporary)) == -1)
+    {
+        return -1;
+    }
+
+    if ((file = fdopen(fd, "w")) == NULL)
+    {
+        (void) close(fd);
+        (void) unlink(temporary);
+        return -1;
+    }
+
+    if (fprintf(file, "#!/bin/sh\necho %s\n", word) < 0 || fchmod(fd, 0755) == -1 ||
+        fclose(file) == EOF || rename(temporary, path) == -1)
+    {
+        (void) unlink(temporary);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Run a program without a shell and read the first line of its output
+ *
+ * \param name name of the program, searched in PATH
+ * \param buffer where to store the line
+ * \param size size of buffer
+ *
+ * \return 0 on success or -1 in case of error (errno is set by mypopen_ex()
+ *         if the program could not be started)
+ */
+static int runprogram(
+    const char * const name,
+    char * const buffer,
+    const size_t size
+    )
+{
+    char *argv[] = { NULL, NULL };
+    struct mypopen_attr attr;
+    FILE *stream;
+    int saved_errno;
+
+    argv[0] = (char *) name;
+    mypopen_attr_init(&attr);
+    attr.argv = argv;
+
+    if ((stream = mypopen_ex(name, "r", &attr)) == NULL)
+    {
+        return -1;
+    }
+
+    buffer[0] = '\0';
+
+    if (fgets(buffer, (int) size, stream) == NULL)
+    {
+        saved_errno = errno;
+        (void) mypclose(stream);
+        errno = saved_errno;
+        return -1;
+    }
+
+    return mypclose(stream) == 0 ? 0 : -1;
+}
+
+/**
+ * \brief Read the whole output of a command with mypdrain()
+ *
+ * \param command command to be executed
+ * \param stats where to store the statistics of the output
+ *
+ * \return 0 on success or -1 in case of error or if the command failed
+ */
+static int draincommand(
+    const char * const command,
+    struct mypdrain_stats * const stats
+    )
+{
+    FILE *stream;
+    int saved_errno;
+
+    if ((stream = mypopen(command, "r")) == NULL)
+    {
+        return -1;
+    }
+
+    if (mypdrain(stream, stats) == -1)
+    {
+        saved_errno = errno;
+        (void) mypclose(stream);
+        errno = saved_errno;
+        return -1;
+    }
+
+    return mypclose(stream) == 0 ? 0 : -1;
+}
+
+/**
+ * \brief Record the order in which mypbatch() completes its commands
+ *
+ * \param index index of the completed command
+ * \param result result of the command
+ * \param data array of indices, the first element counting the ones stored
+ */
+static void recordbatch(
+    size_t index,
+    const struct mypbatch_result *result,
+    void *data
+    )
+{
+    size_t * const order = data;
+
+    (void) result;
+
+    order[++order[0]] = index;
+}
+
+/**
+ * \brief Find the largest number of commands running at the same time
+ *
+ * \param path name of a file every command appends "+" to on start and
+ *        "-" to on exit, one per line
+ *
+ * \return largest number of commands that had started but not exited
+ */
+static int maxrunning(
+    const char * const path
+    )
+{
+    char line[MAXLINE];
+    FILE *file;
+    int running = 0;
+    int max = 0;
+
+    if ((file = fopen(path, "r")) == NULL)
+    {
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        running += line[0] == '+' ? 1 : -1;
+
+        if (running > max)
+        {
+            max = running;
+        }
+    }
+
+    (void) fclose(file);
+
+    return max;
+}
+
+/**
+ * \brief Read the output of a child created with a pipe from it and wait for it
+ *
+ * \param child process id of the child
+ * \param fd pipe from the child, closed by this function
+ * \param buffer where to store the output as a string
+ * \param size size of buffer
+ *
+ * \return exit status of the child or -1 in case of error
+ */
+static int readspawned(
+    const pid_t child,
+    const int fd,
+    char * const buffer,
+    const size_t size
+    )
+{
+    size_t done = 0;
+    ssize_t n;
+    int wstatus;
+
+    while (done + 1 < size && (n = read(fd, buffer + done, size - done - 1)) != 0)
+    {
+        if (n == -1 && errno != EINTR)
+        {
+            break;
+        }
+
+        done += n > 0 ? (size_t) n : 0;
+    }
+
+    buffer[done] = '\0';
+
+    (void) close(fd);
+
+    if (waitpid(child, &wstatus, 0) != child || !WIFEXITED(wstatus))
+    {
+        return -1;
+    }
+
+    return WEXITSTATUS(wstatus);
+}
+
+/**
+ * \brief Spawn a child process
+ *
+ * This function spawns a child process executing the function \a func
+ * with the name \a funcname. - Afterwards the function waits for the proper
+ * termination of the child process.
+ *
+ * \param test pointer to the test description
+ *
+ * \return nothing
+ *
+ */
+static void spawn(const struct test * const test)
+{
+    pid_t pid;
+    int status = 0;
+    const pid_t childpid = fork();
+    switch (childpid)
+    {
+    case -1:
+        bailout("Cannot create child process for executing %s()", test->testfunc_name);
+        break;
+        
+    case 0:
+        TRACE("Child process %d is executing %s() ...\n", getpid(), test->testfunc_name);
+
+        test->testfunc(test->testfunc_name, test->testfunc_desc);
+
+        exit(EXIT_SUCCESS);
+        break;
+
+    default:
+        TRACE("Spawned child process %d executing %s() ...\n", childpid, test->testfunc_name);
+
+        while ((pid = waitpid(childpid, &status, 0)) != childpid)
+        {
+            if ((pid == -1) && (errno != EINTR))
+            {
+                bailout("Cannot wait child process %d executing %s()", childpid, test->testfunc_name);
+            }
+        }
+
+        if (WIFEXITED(status))
+        {
+            TRACE(
+                "Child process %d executing %s() terminated with status %d ...\n",
+                childpid,
+                test->testfunc_name,
+                WEXITSTATUS(status)
+                );
+        }
+        else
+        {
+            TRACE("Child process %d executing %s() terminated abnormally ...\n", childpid, test->testfunc_name);
+        }
+        break;
+    }
+}
+
+/**
+ * \brief Read whatever is available from one of the output pipes of a job
+ *
+ * \param job the job the pipe belongs to
+ * \param i 0 for the stdout pipe, 1 for the stderr pipe
+ *
+ * \return nothing
+ *
+ */
+static void collectoutput(struct job * const job, const int i)
+{
+    struct output * const out = &job->out[i];
+    ssize_t n;
+
+    for (;;)
+    {
+        if (out->size - out->len < JOB_READ_CHUNK)
+        {
+            const size_t size = (out->size == 0) ? JOB_READ_CHUNK * 4 : out->size * 2;
+            char * const data = realloc(out->data, size);
+
+            if (data == NULL)
+            {
+                bailout("Cannot collect output of %s()", job->test->testfunc_name);
+            }
+
+            out->data = data;
+            out->size = size;
+        }
+
+        n = read(job->fd[i], out->data + out->len, out->size - out->len);
+
+        if (n > 0)
+        {
+            out->len += (size_t) n;
+            continue;
+        }
+
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            /* EOF or error - nothing more to collect on this pipe */
+            (void) close(job->fd[i]);
+            job->fd[i] = -1;
+        }
+
+        errno = 0;
+        return;
+    }
+}
+
+/**
+ * \brief Start a test in a child process with its output redirected to pipes
+ *
+ * \param job the job describing the test to be started
+ * \param jobs all jobs (the pipes of the other jobs are closed in the child)
+ * \param njobs number of elements in \a jobs
+ *
+ * \return nothing
+ *
+ */
+static void startjob(struct job * const job, struct job * const jobs, const size_t njobs)
+{
+    int pipes[2][2];
+    int i;
+
+    for (i = 0; i < 2; ++i)
+    {
+        if (pipe(pipes[i]) == -1)
+        {
+            bailout("Cannot create pipe for executing %s()", job->test->testfunc_name);
+        }
+    }
+
+    /* flush before forking, otherwise buffered output shows up twice */
+    (void) fflush(stdout);
+    (void) fflush(stderr);
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &job->start);
+
+    switch (job->pid = fork())
+    {
+    case -1:
+        bailout("Cannot create child process for executing %s()", job->test->testfunc_name);
+        break;
+
+    case 0:
+    {
+        size_t j;
+
+        /* the tests check for leaked file descriptors - do not leak ours */
+        for (j = 0; j < njobs; ++j)
+        {
+            for (i = 0; i < 2; ++i)
+            {
+                if (jobs[j].fd[i] != -1)
+                {
+                    (void) close(jobs[j].fd[i]);
+                }
+            }
+        }
+
+        for (i = 0; i < 2; ++i)
+        {
+            (void) close(pipes[i][0]);
+
+            if (dup2(pipes[i][1], STDOUT_FILENO + i) == -1)
+            {
+                _exit(EXIT_FAILURE);
+            }
+
+            (void) close(pipes[i][1]);
+        }
+
+        TRACE("Child process %d is executing %s() ...\n", getpid(), job->test->testfunc_name);
+
+        job->test->testfunc(job->test->testfunc_name, job->test->testfunc_desc);
+
+        exit(EXIT_SUCCESS);
+        break;
+    }
+
+    default:
+        TRACE2("Spawned child process %d executing %s() ...\n", job->pid, job->test->testfunc_name);
+
+        for (i = 0; i < 2; ++i)
+        {
+            (void) close(pipes[i][1]);
+
+            job->fd[i] = pipes[i][0];
+
+            if (fcntl(job->fd[i], F_SETFL, O_NONBLOCK) == -1)
+            {
+                bailout("Cannot make pipe of %s() non-blocking", job->test->testfunc_name);
+            }
+        }
+        break;
+    }
+}
+
+/**
+ * \brief Check whether the child process executing a job has terminated
+ *
+ * Once the child process has terminated the remaining output is collected
+ * without waiting for EOF, since processes left behind by the test might
+ * still keep the pipes open.
+ *
+ * \param job the job to be checked
+ *
+ * \return nothing
+ *
+ */
+static void reapjob(struct job * const job)
+{
+    pid_t pid;
+    int status = 0;
+    int i;
+
+    while ((pid = waitpid(job->pid, &status, WNOHANG)) == -1)
+    {
+        if (errno != EINTR)
+        {
+            bailout("Cannot wait child process %d executing %s()", job->pid, job->test->testfunc_name);
+        }
+    }
+
+    if (pid == 0)
+    {
+        return;
+    }
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &job->end);
+
+    for (i = 0; i < 2; ++i)
+    {
+        if (job->fd[i] != -1)
+        {
+            collectoutput(job, i);
+
+            if (job->fd[i] != -1)
+            {
+                (void) close(job->fd[i]);
+                job->fd[i] = -1;
+            }
+        }
+    }
+
+    if (WIFEXITED(status))
+    {
+        TRACE2(
+            "Child process %d executing %s() terminated with status %d ...\n",
+            job->pid,
+            job->test->testfunc_name,
+            WEXITSTATUS(status)
+            );
+    }
+    else
+    {
+        TRACE2("Child process %d executing %s() terminated abnormally ...\n", job->pid, job->test->testfunc_name);
+    }
+
+    job->done = 1;
+}
+
+/**
+ * \brief Print the collected output of a finished job
+ *
+ * \param job the job to be printed
+ *
+ * \return nothing
+ *
+ */
+static void printjob(struct job * const job)
+{
+    long int ms;
+    int i;
+
+    for (i = 0; i < 2; ++i)
+    {
+        FILE * const stream = (i == 0) ? stdout : stderr;
+
+        if (job->out[i].len > 0 && fwrite(job->out[i].data, 1, job->out[i].len, stream) != job->out[i].len)
+        {
+            bailout("Cannot write output of %s()", job->test->testfunc_name);
+        }
+
+        if (fflush(stream) == EOF)
+        {
+            bailout("Cannot flush output of %s()", job->test->testfunc_name);
+        }
+
+        free(job->out[i].data);
+        job->out[i].data = NULL;
+    }
+
+    ms = (job->end.tv_sec - job->start.tv_sec) * 1000L + (job->end.tv_nsec - job->start.tv_nsec) / 1000000L;
+
+    say(stderr, "%s: Test \"%s\" took %ld.%03lds\n", cmd, job->test->testfunc_name, ms / 1000, ms % 1000);
+}
+
+/**
+ * \brief Spawn child processes for several tests running concurrently
+ *
+ * This function executes the tests \a tests with at most \a maxjobs of them
+ * running at the same time, each one in a child process of its own. - The
+ * output of each test is collected and printed as a whole (together with
+ * the wall time the test took) in the order given in \a tests.
+ *
+ * \param tests the tests to be executed
+ * \param ntests number of elements in \a tests
+ * \param maxjobs maximum number of tests running concurrently
+ *
+ * \return nothing
+ *
+ */
+static void spawnparallel(const struct test * const * const tests, const size_t ntests, const unsigned int maxjobs)
+{
+    struct job *jobs;
+    struct pollfd *pollfds;
+    struct job **polled;
+    size_t next = 0;
+    size_t printed = 0;
+    size_t i;
+
+    jobs = calloc(ntests, sizeof(*jobs));
+    pollfds = calloc(ntests * 2, sizeof(*pollfds));
+    polled = calloc(ntests * 2, sizeof(*polled));
+    if ((jobs == NULL) || (pollfds == NULL) || (polled == NULL))
+    {
+        bailout("Cannot allocate jobs");
+    }
+
+    for (i = 0; i < ntests; ++i)
+    {
+        jobs[i].test = tests[i];
+        jobs[i].pid = (pid_t) -1;
+        jobs[i].fd[0] = jobs[i].fd[1] = -1;
+    }
+
+    while (printed < ntests)
+    {
+        nfds_t npollfds = 0;
+        unsigned int running = 0;
+        int j;
+
+        for (i = printed; i < next; ++i)
+        {
+            running += (jobs[i].done == 0);
+        }
+
+        while (running < maxjobs && next < ntests)
+        {
+            startjob(&jobs[next++], jobs, ntests);
+            ++running;
+        }
+
+        for (i = printed; i < next; ++i)
+        {
+            for (j = 0; j < 2; ++j)
+            {
+                if (jobs[i].fd[j] != -1)
+                {
+                    pollfds[npollfds].fd = jobs[i].fd[j];
+                    pollfds[npollfds].events = POLLIN;
+                    polled[npollfds++] = &jobs[i];
+                }
+            }
+        }
+
+        if (poll(pollfds, npollfds, JOB_POLL_TIMEOUT_MS) == -1 && errno != EINTR)
+        {
+            bailout("Cannot poll output of tests");
+        }
+
+        for (i = 0; i < npollfds; ++i)
+        {
+            if (pollfds[i].revents != 0)
+            {
+                collectoutput(polled[i], (pollfds[i].fd == polled[i]->fd[0]) ? 0 : 1);
+            }
+        }
+
+        for (i = printed; i < next; ++i)
+        {
+            if (!jobs[i].done)
+            {
+                reapjob(&jobs[i]);
+            }
+        }
+
+        while (printed < next && jobs[printed].done)
+        {
+            printjob(&jobs[printed++]);
+        }
+    }
+
+    free(polled);
+    free(pollfds);
+    free(jobs);
+}
+
+/**
+ * \brief Test 00
+ *
+ * Try to call mypclose() prior to mypopen() - This should yield an error
+ * and errno should be set to ECHILD
+ *
+ * \return Nothing
+ */
+void mypopentest00(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    /*
+     * take caution here, since this might hang if passed a bogus file
+     * pointer (i.e., one not obtained via popen())
+     */
+    (void) alarm(5);
+
+    TRACE0("Trying mypclose(bogusreadfp) ...\n");
+
+    errno = 0;
+
+    if ((mypclose(bogusreadfp) != -1) || (errno != ECHILD))
+    {
+        bogusreadfp = NULL; /* mypclose has closed this one */
+        alarmoccurred = 0;
+
+        FAIL(MANDATORY);
+    }
+
+    if (alarmoccurred == 1)
+    {
+        bogusreadfp = NULL; /* mypclose has closed this one */
+        alarmoccurred = 0;
+
+        FAIL(MANDATORY);
+    }
+
+    /*
+     * take caution here, since this might hang if passed a bogus file
+     * pointer (i.e., one not obtained via popen())
+     */
+    (void) alarm(5);
+
+    TRACE0("Trying mypclose(boguswritefp) ...\n");
+
+    errno = 0;
+
+    if ((mypclose(boguswritefp) != -1)  || (errno != ECHILD))
+    {
+        boguswritefp = NULL; /* mypclose has closed this one */
+        alarmoccurred = 0;
+
+        FAIL(MANDATORY);
+    }
+
+    if (alarmoccurred == 1)
+    {
+        boguswritefp = NULL; /* mypclose has closed this one */
+        alarmoccurred = 0;
+
+        FAIL(MANDATORY);
+
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 01
+ *
+ * Try to call mypopen() twice (without an intermediate mypclose()) -
+ * This should yield an error and errno should be set to EAGAIN.
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest01(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Trying mypopen(\"date 2> /dev/null\", \"r\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("date 2> /dev/null", "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Trying mypopen(\"ls 2> /dev/null\", \"r\") ...\n");
+
+    errno = 0;
+
+    if (((fp[1] = MYCHECKEDPOPEN("ls 2> /dev/null", "r")) != NULL) || (errno != EAGAIN))
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Trying mypclose(fp[0]) ...\n");
+
+    /*
+     *  call mypclose() in a checked way, since it might fail
+     */
+    if (mypclose(fp[0]) == -1)
+    {
+        fp[0] = NULL;
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 02
+ *
+ * Try to call mypclose() with a bogus file pointer (i.e., one that
+ * has not been obtained via mypopen(). - This should yield an error
+ * and errno should be set to EINVAL.
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest02(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Trying mypopen(\"cat\", \"w\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("cat", "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    /*
+     * take caution here, since this might hang if passed a bogus file
+     * pointer (i.e., one not obtained via mypopen())
+     */
+
+    /*
+     * store fp in global var, so that signal handler can close it upon
+     * alarm
+     */
+    fptoclose = (volatile FILE **) &(fp[0]);
+
+    (void) alarm(5);
+
+    TRACE0("Trying mypclose(bogusreadfp) ...\n");
+
+    errno = 0;
+
+    if ((mypclose(bogusreadfp) != -1)  || (errno != EINVAL))
+    {
+        bogusreadfp = NULL; /* myclose has closed this one */
+        alarmoccurred = 0;
+
+        FAIL(MANDATORY);
+    }
+
+    /*
+     * cancel alarm
+     */
+    (void) alarm(0);
+
+    TRACE0("Checking whether mypclose() timed out ...\n");
+
+    if (alarmoccurred == 1)
+    {
+        alarmoccurred = 0;
+
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 03
+ *
+ * Try to call mypclose() with NULL as file pointer. - This should yield
+ * an error and errno should be set to EINVAL.
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest03(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    ENTER();
+
+    initresources();
+
+    setTestName(testname, testdescription);
+
+    TRACE0("Trying mypopen(\"cat\", \"w\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("cat", "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    /*
+     * take caution here, since this might hang if passed a bogus file
+     * pointer (i.e., one not obtained via mypopen())
+     */
+
+    /*
+     * store fp in global var, so that signal handler can close it upon
+     * alarm
+     */
+    fptoclose = (volatile FILE **) &(fp[0]);
+
+    (void) alarm(5);
+
+    TRACE0("Trying mypclose(NULL) ...\n");
+
+    errno = 0;
+
+    if ((mypclose(NULL) != -1)  || (errno != EINVAL))
+    {
+        bogusreadfp = NULL; /* myclose has closed this one */
+        alarmoccurred = 0;
+
+        FAIL(OPTIONAL);
+    }
+
+    /*
+     * cancel alarm
+     */
+    (void) alarm(0);
+
+    TRACE0("Checking whether mypclose() timed out ...\n");
+
+    if (alarmoccurred == 1)
+    {
+        alarmoccurred = 0;
+
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 04
+ *
+ * Try to call mypopen() with a type parameter of "x" -  This should
+ * yield an error and errno should be set to EINVAL.
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest04(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Trying mypopen(\"cat\", \"x\") ...\n");
+
+    errno = 0;
+
+    if (((fp[0] = MYCHECKEDPOPEN("cat", "x")) != NULL) || (errno != EINVAL))
+    {
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 05
+ *
+ * Try to call mypopen() with a type parameters "rotz" and "what the ..."
+ * (i.e., something that start with 'r' and 'w' but is actually a string
+ * different from "r" and "w". - This should yield and error and errno
+ * should be set to EINVAL.
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest05(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Trying mypopen(\"ls\", \"rotz\") ...\n");
+
+    errno = 0;
+
+    if (((fp[0] = MYCHECKEDPOPEN("ls", "rotz")) != NULL) || (errno != EINVAL))
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Trying mypopen(\"cat\", \"what the ...\") ...\n");
+
+    errno = 0;
+
+    if (((fp[1] = MYCHECKEDPOPEN("cat", "what the ....")) != NULL) || (errno != EINVAL))
+    {
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 06
+ *
+ * Call mypopen() with a command that requires input. Check if the created
+ * child process is really there.
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ * Call mypclose() and check if the exit status of the child process has
+ * been properly consumed via wait() or waitpid().
+ *
+ * \return Nothing
+ */
+void mypopentest06(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    char popencommand[] = POPENCOMMAND PIDPATTERN;
+    char findprocesscommand[] = FINDPROCESSCOMMAND POPENCOMMAND PIDPATTERN;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    (void) snprintf(
+        popencommand,
+        sizeof(popencommand),
+        POPENCOMMAND,
+        getpid()
+        );
+
+    (void) snprintf(
+        findprocesscommand,
+        sizeof(findprocesscommand),
+        FINDPROCESSCOMMAND,
+        popencommand
+        );
+
+    initresources();
+
+    TRACE0("Trying mypopen(\"%s\", \"w\") ...\n", popencommand);
+
+    if ((fp[0] = mypopen(popencommand, "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing system(\"%s\") ...\n", findprocesscommand);
+
+
+    blockonwrite(fp[0]);
+    /* sleep(SLEEPTIME); */
+
+    /* check if child is there and living - must be there */
+    if (system(findprocesscommand) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) ...\n");
+
+    if (mypclose(fp[0]) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    TRACE0("Doing system(\"%s\") ...\n", findprocesscommand);
+
+
+    /*  sleep(SLEEPTIME); */
+
+    /* check if child is there and living - must NOT be there*/
+    if (system(findprocesscommand) == 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 07
+ *
+ * Call mypopen(), fork(), mypclose() - forked child process must
+ * still be there
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest07(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    char popencommand[] = POPENCOMMAND PIDPATTERN;
+    char findprocesscommand[] = FINDPROCESSCOMMAND POPENCOMMAND PIDPATTERN;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    (void) snprintf(
+        popencommand,
+        sizeof(popencommand),
+        POPENCOMMAND,
+        getpid()
+        );
+
+    (void) snprintf(
+        findprocesscommand,
+        sizeof(findprocesscommand),
+        FINDPROCESSCOMMAND,
+        popencommand
+        );
+
+    initresources();
+
+    TRACE0("Trying mypopen(\"%s\", \"w\") ...\n", popencommand);
+
+    if ((fp[0] = MYCHECKEDPOPEN(popencommand, "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Creating dummy child ...\n");
+
+    /* create dummy child */
+    switch (dummychildpid = fork())
+    {
+    case -1:
+        bailout("Cannot create child");
+        break;
+
+    case 0:
+        exit(EXIT_SUCCESS); /* be a zombie */
+        break;
+
+    default:
+        break;
+    }
+
+    TRACE0("Doing system(\"%s\") ...\n", findprocesscommand);
+
+    blockonwrite(fp[0]);
+    /*  sleep(SLEEPTIME); */
+
+    /* check if child is there and living - must be there */
+    if (system(findprocesscommand) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) ...\n");
+
+    if (mypclose(fp[0]) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    TRACE0("Doing system(\"%s\") ...\n", findprocesscommand);
+
+    /* sleep(SLEEPTIME); */
+
+    /* check if child is there and living - must NOT be there*/
+    if (system(findprocesscommand) == 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Checking if dummy child is still there (as a zombie) ...\n");
+
+    /* check if other child is still there (as a zombie) */
+    if (kill(dummychildpid, 0) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 08
+ *
+ * Call mypopen("echo 'This is a test.'; sleep 1; echo 'Second line
+ * for test.'", "r"); read from file pointer; check if we read the two
+ * lines; call mypclose()
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest08(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    char buffer[MAXLINE];
+
+    const char * const popen_cmd = "echo '" LINE1 "'; sleep 1; echo '" LINE2 "'";
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Doing mypopen(\"%s\") ...\n", popen_cmd);
+
+    if (
+        (fp[0] = MYCHECKEDPOPEN(
+            popen_cmd,
+            "r"
+            )
+            ) == NULL
+        )
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Trying to read from pipe ...\n");
+
+    if (fgets(buffer, sizeof(buffer), fp[0]) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Comparing line read with expected result ...\n");
+
+    if (strcmp(buffer, LINE1 "\n") != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Trying to read from pipe ...\n");
+
+    if (fgets(buffer, sizeof(buffer), fp[0]) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Comparing line read with expected result ...\n");
+
+    if (strcmp(buffer, LINE2 "\n") != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Trying to read from pipe - should yield EOF ...\n");
+
+    if ((fgets(buffer, sizeof(buffer), fp[0]) != NULL) || (!feof(fp[0])))
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) ...\n");
+
+    if (mypclose(fp[0]) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 09
+ *
+ * Call mypopen("cat > some_temp_file", "w"); write to file pointer;
+ * check if some_temp_file contains the respective text.
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest09(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    char buffer[MAXLINE];
+    char tempfilename[] = "/tmp/popen.XXXXXXX";
+    char popencommand[sizeof(tempfilename) + sizeof(POPENCOMMAND2)];
+    int tempfile;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Getting name of tempfile ...\n");
+
+    tempfile = mkstemp(tempfilename);
+    if (tempfile == -1)
+    {
+        bailout("Cannot create temporary file");
+    }
+
+    (void) snprintf(
+        popencommand,
+        sizeof(popencommand),
+        POPENCOMMAND2,
+        tempfilename
+        );
+
+    TRACE0("Doing mypopen(\"%s\", \"w\") ...\n", popencommand);
+
+    if ((fp[0] = MYCHECKEDPOPEN(popencommand, "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Trying to write to pipe ...\n");
+
+    if (fputs(LINE1 "\n", fp[0]) == EOF)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Trying to write to pipe ...\n");
+
+    if (fputs(LINE2 "\n", fp[0]) == EOF)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) ...\n");
+
+    if (mypclose(fp[0]) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    TRACE("Opening temporary file %s ...\n", tempfilename);
+
+    if ((somefp = fopen(tempfilename, "r")) == NULL)
+    {
+        bailout("Cannot open temporary file for reading");
+    }
+
+    TRACE("Trying to read a line from file %s ...\n", tempfilename);
+
+    if (fgets(buffer, sizeof(buffer), somefp) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Comparing line read with expected result ...\n");
+
+    if (strcmp(buffer, LINE1 "\n") != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Trying to read a line from file %s ...\n", tempfilename);
+
+    if (fgets(buffer, sizeof(buffer), somefp) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Comparing line read with expected result ...\n");
+
+    if (strcmp(buffer, LINE2 "\n") != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Trying to read from pipe - should yield EOF ...\n");
+
+    if ((fgets(buffer, sizeof(buffer), somefp) != NULL) || (!feof(somefp)))
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Closing temporary file ...\n");
+
+    fclose(somefp);
+    somefp = NULL;
+
+    TRACE("Removing temporary file ...\n");
+
+    if (remove(tempfilename) == -1)
+    {
+        bailout("Cannot remove temporary file");
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 10
+ *
+ * Set via setrlimit(2) the resource limit for open files
+ * (RLIMIT_NOFILE) to 1; call mypopen() and check whether it fails (i.e,
+ * return NULL with errno set to EMFILE) due to the failing pipe() call.
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest10(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    struct rlimit openfiles;
+    rlim_t oldlimit;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE("Getting resource limit on open files ...\n");
+
+    if (getrlimit(RLIMIT_NOFILE, &openfiles) == -1)
+    {
+        bailout("Cannot obtain current resource limit on open files");
+    }
+
+    /* lower limit to 1 - ensure that next try to open a file fails */
+    oldlimit = openfiles.rlim_cur;
+    openfiles.rlim_cur = 1;
+
+    TRACE0("Lowering resource limit on open files to 1 ...\n");
+
+    if (setrlimit(RLIMIT_NOFILE, &openfiles) == -1)
+    {
+        bailout("Cannot set current resource limit on open files");
+    }
+
+    /* prepare to restore old limit */
+    openfiles.rlim_cur = oldlimit;
+
+    TRACE0("Trying mypopen(\"ls -al 2> /dev/null\", \"r\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("ls -al 2> /dev/null", "r")) != NULL)
+    {
+        TRACE0("Restoring old resource limit on open files ...\n");
+
+        /* restore old limit */
+        if (setrlimit(RLIMIT_NOFILE, &openfiles) == -1)
+        {
+            bailout("Cannot set current resource limit on open files");
+        }
+
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Restoring old resource limit on open files ...\n");
+
+    /* restore old limit */
+    if (setrlimit(RLIMIT_NOFILE, &openfiles) == -1)
+    {
+        bailout("Cannot set current resource limit on open files");
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 11
+ *
+ * Set via setrlimit(2) the resource limit for processes
+ * (RLIMIT_NPROC); call mypopen() and check whether it fails with
+ * errno set to EAGAIN (due to the failing fork() call).
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ * Furthermore verify that the pipe is properly closed in case fork() fails.
+ * Last but not least call mypclose() and check that it fails as well in
+ * order to test is the stored static PID for the child is properly initialized
+ * to -1 (the value returned by a failed fork) and/or properly reset to -1
+ * upon a failed fork().
+ *
+ * \return Nothing
+ */
+void mypopentest11(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    struct rlimit processes;
+    rlim_t oldlimit;
+    int blah = 0;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    /* No initresources() here, since we only want stdin, stdout, stderr to be open */
+
+    TRACE("Ensuring that only stdin, stdout, stderr are open ...\n");
+
+    /* check that pipe has been properly removed => only stdin, stdout, stderr open */
+    if (!VERIFY_CLOSED_NON_STD_FDS())
+    {
+	bailout("File descriptors other than stdin, stdout, stderr are open");
+    }
+
+    TRACE("Getting resource limit on processes ...\n");
+
+    if (getrlimit(RLIMIT_NPROC, &processes) == -1)
+    {
+        bailout("Cannot obtain current resource limit on number of processes");
+    }
+
+    /* lower limit to 1 - ensure that next try to open a file fails */
+    oldlimit = processes.rlim_cur;
+    processes.rlim_cur = 1;
+
+    TRACE0("Lowering resource limit on processes to 1 ...\n");
+
+    if (setrlimit(RLIMIT_NPROC, &processes) == -1)
+    {
+        bailout("Cannot set current resource limit on number of processes");
+    }
+
+    /* prepare to restore old limit */
+    processes.rlim_cur = oldlimit;
+
+    TRACE0("Trying mypopen(\"ls -al 2> /dev/null\", \"r\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("ls -al 2> /dev/null", "r")) != NULL)
+    {
+        TRACE("Restoring old resource limit on processes ...\n");
+
+        /* restore old limit */
+        if (setrlimit(RLIMIT_NPROC, &processes) == -1)
+        {
+            bailout("Cannot set current resource limit on number of processes");
+        }
+
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Restoring old resource limit on processes ...\n");
+
+    /* restore old limit */
+    if (setrlimit(RLIMIT_NPROC, &processes) == -1)
+    {
+        bailout("Cannot set current resource limit on number of processes");
+    }
+
+    TRACE("Verifying that only stdin, stdout, stderr are open ...\n");
+
+    /* check that pipe has been properly removed => only stdin, stdout, stderr open */
+    if (!VERIFY_CLOSED_NON_STD_FDS())
+    {
+	FAIL(MANDATORY);
+    }
+
+    TRACE("Verifying that mypclose() returns -1 since mypopen() did not succeed ...\n");
+
+    /*
+     * myclose() should signal an error here since mypopen() has not been
+     * called successfully yet
+     */
+    if (((blah = mypclose(fp[0])) != -1) || (errno != ECHILD))
+    {
+        FAIL(MANDATORY);
+    }
+
+    /* No freeresources() here, since we did not call initresources() */
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 12
+ *
+ * Check whether the exit status of the child process is extracted
+ * properly with wait() or waitpid().
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest12(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Doing mypopen(\"exit %d\", \"r\") ...\n", EXPECTED_EXIT_STATUS);
+
+    if ((fp[0] = MYCHECKEDPOPEN("exit " EXPECTED_EXIT_STATUS_STRING, "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) ...\n");
+
+    if (mypclose(fp[0]) != EXPECTED_EXIT_STATUS)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 13
+ *
+ * Check for correct setting of errno to ECHILD in case the exit status
+ * cannot be extracted (i.e., if WIFEXITED() returns FALSE).
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest13(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    int blah = 0;
+    char command[MAX_COMMAND_LENGTH];
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    snprintf(
+	command,
+	sizeof(command),
+	"./killparent%s %lu",
+	getVerbose() > 0 ? " -v" : "",
+	(unsigned long) getpid()
+	);
+
+    TRACE0("Doing mypopen(\"%s\", \"r\") ...\n", command);
+
+    if ((fp[0] = MYCHECKEDPOPEN(command, "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) ...\n");
+
+    errno = 0;
+
+    if (((blah = mypclose(fp[0])) != -1) || (errno != ECHILD))
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 14
+ *
+ * Checks if the stored static PID for the child and the stored static
+ * file pointer are properly properly reset (or remain set) to invalid values if
+ * mypopen() fails somewhere in between (e.g., upon fdopen()). => Let
+ * fdopen() fail by installing a malloc_hook(3) that returns NULL and
+ * check if mypopen() can be called again ...).
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest14(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Doing mypopen(\"ls -al 2> /dev/null\", \"r\") - Should fail ...\n");
+
+    let_malloc_fail = 1;
+
+    if ((fp[0] = MYCHECKEDPOPEN("ls -al 2> /dev/null", "r")) != NULL)
+    {
+	let_malloc_fail = 0;
+
+        FAIL(MANDATORY);
+    }
+
+    let_malloc_fail = 0;
+
+    TRACE0("Doing mypopen(\"ls -al 2> /dev/null\", \"r\") - Should now succeed ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("ls -al 2> /dev/null", "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) - Should succeed ...\n");
+
+    if (mypclose(fp[0]) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 15
+ *
+ * Call mypopen() with mode set to reading. Verify that stdin, stdout,
+ * stderr, and the read end of the pipe are the only open file
+ * descriptors after the mypopen() call.  Call mypclose(). Verify that
+ * stdin, stdout, and stderr are the only open file descriptors after
+ * the mypclose() call (i.e., verify that the read end of the pipe has
+ * been properly closed).
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest15(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    int fds_allowed_open[] =
+    {
+	STDIN_FILENO,
+	STDOUT_FILENO,
+	STDERR_FILENO,
+	0
+    };
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    /* No initresources() here, since we only want stdin, stdout, stderr to be open */
+
+    TRACE("Ensuring that only stdin, stdout, stderr are open ...\n");
+
+    /* check that pipe has been properly removed => only stdin, stdout, stderr open */
+    if (!VERIFY_CLOSED_NON_STD_FDS())
+    {
+	bailout("File descriptors other than stdin, stdout, stderr are open");
+    }
+
+    TRACE0("Doing mypopen(\"ls -al 2> /dev/null\", \"r\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("ls -al 2> /dev/null", "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Verifying that only read end of pipe, stdin, stdout, and stderr are open ...\n");
+
+    /*
+     * Verify that only fileno(fp[0]), stdin, stdout, stderr are open
+     */
+    fds_allowed_open[3] = fileno(fp[0]);
+    if (!verify_closed_file_desc(fds_allowed_open, ARRAY_SIZE(fds_allowed_open)))
+    {
+	FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) ...\n");
+
+    if (mypclose(fp[0]) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    TRACE("Verifying that only stdin, stdout, and stderr are open ...\n");
+
+    /*
+     * check that pipe has been properly removed and all other non-standard file
+     * descriptors are closed again => only stdin, stdout, stderr open
+     */
+    if (!VERIFY_CLOSED_NON_STD_FDS())
+    {
+	FAIL(MANDATORY);
+    }
+
+    /* No freeresources() here, since we did not call initresources() */
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 16
+ *
+ * Call mypopen() with mode set to reading. Verify that stdin, stdout,
+ * stderr, are the only open file descriptors in the exec()'ed child process.
+ * Call mypclose() and check that it succeeds.
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest16(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+
+    char command[MAX_COMMAND_LENGTH];
+    const int verbose = getVerbose();
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    snprintf(
+	command,
+	sizeof(command),
+	"./checkopenfds%s",
+	verbose == 1 ? " -v" : verbose >= 2 ? " -vv" : ""
+	);
+    /* No initresources() here, since we only want stdin, stdout, stderr to be open */
+
+    TRACE("Ensuring that only stdin, stdout, stderr are open ...\n");
+
+    /* check that pipe has been properly removed => only stdin, stdout, stderr open */
+    if (!VERIFY_CLOSED_NON_STD_FDS())
+    {
+	bailout("File descriptors other than stdin, stdout, stderr are open");
+    }
+
+    TRACE0("Doing mypopen(\"%s\", \"w\") ...\n", command);
+
+    if ((fp[0] = MYCHECKEDPOPEN(command, "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) ...\n");
+
+    if (mypclose(fp[0]) != EXIT_SUCCESS)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    /* No freeresources() here, since we did not call initresources() */
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 17
+ *
+ * Try to call mypclose() with a bogus file pointer (i.e., one that
+ * has not been obtained via mypopen() but where the underlying file
+ * descriptor is identical to the one of a file pointer obtained by
+ * mypopen(). - This should yield an error and errno should be set to EINVAL.
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest17(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    FILE *fakereadfp;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Trying mypopen(\"cat\", \"w\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("cat", "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing fdopen(fileno(fp)) ...\n");
+
+    if ((fakereadfp = fdopen(fileno(fp[0]), "w")) == NULL)
+    {
+	bailout("Cannot create fake file pointer");
+    }
+
+    /*
      * take caution here, since this might hang if passed a bogus file
      * pointer (i.e., one not obtained via mypopen())
      */
 
-    /*
-     * store fp in global var, so that signal handler can close it upon
-     * alarm
-     */
-    fptoclose = (volatile FILE **) &(fp[0]);
+    /*
+     * store fp in global var, so that signal handler can close it upon
+     * alarm
+     */
+    fptoclose = (volatile FILE **) &(fp[0]);
+
+    (void) alarm(5);
+
+    TRACE0("Trying mypclose(fakereadfp) ...\n");
+
+    errno = 0;
+
+    if ((mypclose(fakereadfp) != -1)  || (errno != EINVAL))
+    {
+        fakereadfp = NULL; /* myclose has closed this one */
+        alarmoccurred = 0;
+
+        FAIL(MANDATORY);
+    }
+
+    /*
+     * cancel alarm
+     */
+    (void) alarm(0);
+
+    TRACE0("Checking whether mypclose() timed out ...\n");
+
+    if (alarmoccurred == 1)
+    {
+        alarmoccurred = 0;
+
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 18
+ *
+ * Call mypopen() with mode set to writing. Verify that stdin, stdout,
+ * stderr, and the read end of the pipe are the only open file
+ * descriptors after the mypopen() call.  Call mypclose(). Verify that
+ * stdin, stdout, and stderr are the only open file descriptors after
+ * the mypclose() call (i.e., verify that the read end of the pipe has
+ * been properly closed).
+ * Additionally verify that mypopen() does not return for the created child
+ * process, but properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest18(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    int fds_allowed_open[] =
+    {
+	STDIN_FILENO,
+	STDOUT_FILENO,
+	STDERR_FILENO,
+	0
+    };
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    /* No initresources() here, since we only want stdin, stdout, stderr to be open */
+
+    TRACE("Ensuring that only stdin, stdout, stderr are open ...\n");
+
+    /* check that pipe has been properly removed => only stdin, stdout, stderr open */
+    if (!VERIFY_CLOSED_NON_STD_FDS())
+    {
+	bailout("File descriptors other than stdin, stdout, stderr are open");
+    }
+
+    TRACE0("Doing mypopen(\"grep foo 2> /dev/null\", \"w\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("grep foo 2> /dev/null", "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE("Verifying that only read end of pipe, stdin, stdout, and stderr are open ...\n");
+
+    /*
+     * Verify that only fileno(fp[0]), stdin, stdout, stderr are open
+     */
+    fds_allowed_open[3] = fileno(fp[0]);
+    if (!verify_closed_file_desc(fds_allowed_open, ARRAY_SIZE(fds_allowed_open)))
+    {
+	FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) ...\n");
+
+    if (mypclose(fp[0]) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    TRACE("Verifying that only stdin, stdout, and stderr are open ...\n");
+
+    /*
+     * check that pipe has been properly removed and all other non-standard file
+     * descriptors are closed again => only stdin, stdout, stderr open
+     */
+    if (!VERIFY_CLOSED_NON_STD_FDS())
+    {
+	FAIL(MANDATORY);
+    }
+
+    /* No freeresources() here, since we did not call initresources() */
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 19
+ *
+ * Check whether mypclose() behaves properly (i.e., returns -1 and
+ * sets errno to ECHLD) if waitpid() fails for reasons different from
+ * EINTR.  Additionally verify that mypopen() does not return for the
+ * created child process, but properly invokes exit(3) in the child
+ * process.
+ *
+ * \return Nothing
+ */
+void mypopentest19(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    struct sigaction ignore_sigchld;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    /*
+     * Ignore SIGCHLD => This will cause waitpid() to return -1 and set
+     * errno to ECHLD
+     */
+    memset(&ignore_sigchld, 0, sizeof(ignore_sigchld));
+    ignore_sigchld.sa_handler = SIG_IGN;
+    ignore_sigchld.sa_flags = SA_NOCLDWAIT;
+
+    TRACE0("Installing signal handler ignoring SIGCHLD ...\n");
+
+    if (sigaction(SIGCHLD, &ignore_sigchld, 0) == -1)
+    {
+        bailout("Cannot install signal handler");
+    }
+
+    TRACE0("Doing mypopen(\"exit %d\", \"r\") ...\n", EXPECTED_EXIT_STATUS);
+
+    if ((fp[0] = MYCHECKEDPOPEN("exit " EXPECTED_EXIT_STATUS_STRING, "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose(fp[0]) ...\n");
+
+    errno = 0;
+
+    /*
+     * take caution here, since this might hang if waitpid() fails
+     * and sets errno != EINTR
+     */
+    (void) alarm(5);
+
+    if ((mypclose(fp[0]) != -1) || (errno != ECHILD))
+    {
+        FAIL(MANDATORY);
+    }
+
+    /*
+     * cancel alarm
+     */
+    (void) alarm(0);
+
+    fp[0] = NULL;
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 20
+ *
+ * Do a mypopen() with a really long commandline that causes execl() to
+ * fail and set errno to E2BIG. - Check whether mypopen() is successful
+ * anyway (i.e., returns something != NULL). Additionally verify that
+ * mypopen() does not return for the created child process, but
+ * properly invokes exit(3) in the child process.
+ *
+ * \return Nothing
+ */
+void mypopentest20(
+    const char * const testname, 
+    const char * const testdescription
+    )
+{
+    char command[REALLY_LONG_COMMAND_LENGTH];
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    memset(command, 'x', sizeof(command));
+
+    TRACE0("Trying mypopen(\"%s\", \"r\") ...\n", command);
+
+    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 21
+ *
+ * Enable the output cache, call mypopen() with a command writing more
+ * than fits in a pipe, read only the first line and call mypclose(). -
+ * The command must be ended by SIGPIPE, so mypclose() must not report
+ * success. - Call mypopen() with the same command again and read the
+ * whole output. - Call mypopen() a third time. - The command must not be
+ * run again, the stream must have a file descriptor that polls readable
+ * and the whole output must be read.
+ *
+ * \return Nothing
+ */
+void mypopentest21(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    char counter[] = "/tmp/popen.XXXXXX";
+    char command[MAXLINE];
+    char buffer[MAXLINE];
+    struct pollfd pfd;
+    int lines = 0;
+    int fd;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    if ((fd = mkstemp(counter)) == -1)
+    {
+        bailout("Cannot create temporary file");
+    }
+    (void) close(fd);
+
+    countedcommand(command, sizeof(command), counter, "seq 1 100000");
+
+    if (mypcache_enable(1024 * 1024, -1, 0) == -1)
+    {
+        bailout("Cannot enable the cache");
+    }
+
+    TRACE0("Doing mypopen(\"%s\", \"r\") and reading one line ...\n", command);
+
+    (void) alarm(5);
+
+    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (fgets(buffer, sizeof(buffer), fp[0]) == NULL || strcmp(buffer, "1\n") != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (mypclose(fp[0]) == 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    TRACE0("Doing mypopen(\"%s\", \"r\") and reading all lines ...\n", command);
+
+    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    while (fgets(buffer, sizeof(buffer), fp[0]) != NULL)
+    {
+        ++lines;
+    }
+
+    if (mypclose(fp[0]) != 0 || lines != 100000)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+    lines = 0;
+
+    TRACE0("Doing mypopen(\"%s\", \"r\") again ...\n", command);
+
+    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (countlines(counter) != 2)
+    {
+        FAIL(MANDATORY);
+    }
+
+    pfd.fd = fileno(fp[0]);
+    pfd.events = POLLIN;
+    if (pfd.fd == -1 || poll(&pfd, 1, 0) != 1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    while (fgets(buffer, sizeof(buffer), fp[0]) != NULL)
+    {
+        ++lines;
+    }
+
+    if (lines != 100000 || strcmp(buffer, "100000\n") != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (mypclose(fp[0]) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    (void) alarm(0);
+
+    fp[0] = NULL;
+
+    (void) unlink(counter);
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 22
+ *
+ * Enable the output cache with the working directory as part of the
+ * key. - Read the output of a command twice, the second time from
+ * another working directory, and a different command. - Every one of
+ * them must be a miss that runs its command and gets its own output.
+ *
+ * \return Nothing
+ */
+void mypopentest22(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    char counter[] = "/tmp/popen.XXXXXX";
+    char command[MAXLINE];
+    char other[MAXLINE];
+    char cwd[PATH_MAX];
+    int lines;
+    int fd;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    if ((fd = mkstemp(counter)) == -1)
+    {
+        bailout("Cannot create temporary file");
+    }
+    (void) close(fd);
+
+    countedcommand(command, sizeof(command), counter, "pwd");
+    countedcommand(other, sizeof(other), counter, "pwd; pwd");
+
+    if (getcwd(cwd, sizeof(cwd)) == NULL ||
+        mypcache_enable(1024 * 1024, -1, MYPCACHE_KEY_CWD) == -1)
+    {
+        bailout("Cannot enable the cache");
+    }
+
+    TRACE0("Doing mypopen(\"%s\", \"r\") in two directories ...\n", command);
+
+    if (readcommand(command, &lines) != 0 || lines != 1 || countlines(counter) != 1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (chdir("/") == -1)
+    {
+        bailout("Cannot change the working directory");
+    }
+
+    if (readcommand(command, &lines) != 0 || lines != 1 || countlines(counter) != 2)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypopen(\"%s\", \"r\") ...\n", other);
+
+    if (readcommand(other, &lines) != 0 || lines != 2 || countlines(counter) != 3)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (chdir(cwd) == -1)
+    {
+        bailout("Cannot change the working directory");
+    }
+
+    fp[0] = NULL;
+
+    (void) unlink(counter);
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 23
+ *
+ * Enable the output cache with a lifetime of 200 ms and read the output
+ * of a command. - Reading it again right away must not run the command,
+ * reading it once the lifetime has passed must run it again.
+ *
+ * \return Nothing
+ */
+void mypopentest23(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    const struct timespec expiry = { 0, 300 * 1000 * 1000L };
+    char counter[] = "/tmp/popen.XXXXXX";
+    char command[MAXLINE];
+    int lines;
+    int fd;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    if ((fd = mkstemp(counter)) == -1)
+    {
+        bailout("Cannot create temporary file");
+    }
+    (void) close(fd);
+
+    countedcommand(command, sizeof(command), counter, "echo '" LINE1 "'");
+
+    if (mypcache_enable(1024 * 1024, 200, 0) == -1)
+    {
+        bailout("Cannot enable the cache");
+    }
+
+    TRACE0("Doing mypopen(\"%s\", \"r\") twice ...\n", command);
+
+    if (readcommand(command, &lines) != 0 || lines != 1 ||
+        readcommand(command, &lines) != 0 || lines != 1 || countlines(counter) != 1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypopen(\"%s\", \"r\") after the entry expired ...\n", command);
+
+    (void) nanosleep(&expiry, NULL);
+
+    if (readcommand(command, &lines) != 0 || lines != 1 || countlines(counter) != 2)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    (void) unlink(counter);
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 24
+ *
+ * Enable the output cache and read the output of a command exiting with
+ * status 42 twice. - The output must not be cached, so the command runs
+ * both times and mypclose() returns 42 both times.
+ *
+ * \return Nothing
+ */
+void mypopentest24(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    char counter[] = "/tmp/popen.XXXXXX";
+    char command[MAXLINE];
+    int lines;
+    int fd;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    if ((fd = mkstemp(counter)) == -1)
+    {
+        bailout("Cannot create temporary file");
+    }
+    (void) close(fd);
+
+    countedcommand(command, sizeof(command), counter,
+                   "echo '" LINE1 "'; exit " EXPECTED_EXIT_STATUS_STRING);
+
+    if (mypcache_enable(1024 * 1024, -1, 0) == -1)
+    {
+        bailout("Cannot enable the cache");
+    }
+
+    TRACE0("Doing mypopen(\"%s\", \"r\") twice ...\n", command);
+
+    if (readcommand(command, &lines) != EXPECTED_EXIT_STATUS || lines != 1 ||
+        readcommand(command, &lines) != EXPECTED_EXIT_STATUS || lines != 1 ||
+        countlines(counter) != 2)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    (void) unlink(counter);
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 25
+ *
+ * Call mypopen("sleep 5", "w") and write more than fits in the pipe, so
+ * data stays buffered. - mypclose_timeout() with a deadline of 100 ms
+ * must not block on flushing the data, but return -1 with errno set to
+ * ETIMEDOUT well before the child would exit, with the child terminated
+ * by SIGTERM. - Data the child reads in time must still be flushed.
+ *
+ * \return Nothing
+ */
+void mypopentest25(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    struct timespec start;
+    int wstatus = 0;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Doing mypopen(\"sleep 5\", \"w\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("sleep 5", "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (fwrite(dummybuffer, 1, sizeof(dummybuffer), fp[0]) != sizeof(dummybuffer))
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose_timeout(fp[0], 100, NULL, 0, &wstatus) ...\n");
+
+    (void) alarm(4);
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &start);
+
+    errno = 0;
+
+    if (mypclose_timeout(fp[0], 100, NULL, 0, &wstatus) != -1 || errno != ETIMEDOUT)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    if (elapsedms(&start) > 1000 || !WIFSIGNALED(wstatus) || WTERMSIG(wstatus) != SIGTERM)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypopen(\"sleep 0.2; cat > /dev/null\", \"w\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("sleep 0.2; cat > /dev/null", "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (fwrite(dummybuffer, 1, sizeof(dummybuffer), fp[0]) != sizeof(dummybuffer) ||
+        mypclose_timeout(fp[0], 2000, NULL, 0, &wstatus) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    (void) alarm(0);
+
+    fp[0] = NULL;
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 26
+ *
+ * Call mypopen() with a command ignoring SIGTERM and close it with
+ * mypclose_timeout() after 100 ms, escalating to SIGTERM with a grace
+ * period of 200 ms and then to SIGKILL. - mypclose_timeout() must return
+ * -1 with errno set to ETIMEDOUT after about 300 ms with the child killed
+ * by SIGKILL.
+ *
+ * \return Nothing
+ */
+void mypopentest26(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    const struct mypclose_step steps[] = { { SIGTERM, 200 }, { SIGKILL, -1 } };
+    struct timespec start;
+    int wstatus = 0;
+    long elapsed;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    TRACE0("Doing mypopen(\"trap '' TERM; exec sleep 5\", \"r\") ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("trap '' TERM; exec sleep 5", "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypclose_timeout(fp[0], 100, steps, 2, &wstatus) ...\n");
+
+    (void) alarm(4);
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &start);
+
+    errno = 0;
+
+    if (mypclose_timeout(fp[0], 100, steps, ARRAY_SIZE(steps), &wstatus) != -1 ||
+        errno != ETIMEDOUT)
+    {
+        FAIL(MANDATORY);
+    }
+
+    (void) alarm(0);
+
+    fp[0] = NULL;
+
+    elapsed = elapsedms(&start);
+
+    if (elapsed < 290 || elapsed > 1500 || !WIFSIGNALED(wstatus) || WTERMSIG(wstatus) != SIGKILL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 27
+ *
+ * Call mypclose_abort() on a running child, on a child blocked with a
+ * full pipe and data still buffered, and on a child that has already
+ * exited with status 42. - The first two must return -1 right away with
+ * errno set to ECANCELED and the child killed by SIGKILL, the last one
+ * must return 42.
+ *
+ * \return Nothing
+ */
+void mypopentest27(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    const struct timespec exittime = { 0, 200 * 1000 * 1000L };
+    struct timespec start;
+    int wstatus = 0;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    (void) alarm(4);
+
+    TRACE0("Doing mypopen(\"exec sleep 5\", \"r\") and mypclose_abort() ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("exec sleep 5", "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &start);
+
+    errno = 0;
+
+    if (mypclose_abort(fp[0], &wstatus) != -1 || errno != ECANCELED)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    if (elapsedms(&start) > 1000 || !WIFSIGNALED(wstatus) || WTERMSIG(wstatus) != SIGKILL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypopen(\"exec sleep 5\", \"w\"), filling the pipe and mypclose_abort() ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("exec sleep 5", "w")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (fwrite(dummybuffer, 1, sizeof(dummybuffer), fp[0]) != sizeof(dummybuffer))
+    {
+        FAIL(MANDATORY);
+    }
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &start);
+
+    errno = 0;
+
+    if (mypclose_abort(fp[0], &wstatus) != -1 || errno != ECANCELED)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    if (elapsedms(&start) > 1000 || !WIFSIGNALED(wstatus) || WTERMSIG(wstatus) != SIGKILL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypopen(\"exit %d\", \"r\") and mypclose_abort() ...\n", EXPECTED_EXIT_STATUS);
+
+    if ((fp[0] = MYCHECKEDPOPEN("exit " EXPECTED_EXIT_STATUS_STRING, "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    (void) nanosleep(&exittime, NULL);
+
+    if (mypclose_abort(fp[0], &wstatus) != EXPECTED_EXIT_STATUS)
+    {
+        FAIL(MANDATORY);
+    }
+
+    (void) alarm(0);
+
+    fp[0] = NULL;
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 28
+ *
+ * Call mypopen_ex() with MYPOPEN_SETPGRP and a shell that starts a
+ * background grandchild. - mypkill() must signal the whole process
+ * group, so the grandchild terminates as well. - Do the same with a
+ * grandchild ignoring SIGTERM and mypclose_timeout(): once the close had
+ * to escalate, whatever is left of the group must be killed.
+ *
+ * \return Nothing
+ */
+void mypopentest28(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    pid_t grandchild = -1;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    (void) alarm(4);
+
+    TRACE0("Doing mypopen_ex() with MYPOPEN_SETPGRP and mypkill(fp[0], SIGTERM) ...\n");
+
+    if (openwithgrandchild("sleep 30 & echo $!; wait", MYPOPEN_SETPGRP, &grandchild) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (mypkill(fp[0], SIGTERM) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    errno = 0;
+
+    if (mypclose(fp[0]) != -1 || errno != ECHILD)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    if (!waitgone(grandchild, 1000))
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypopen_ex() with MYPOPEN_SETPGRP and mypclose_timeout() ...\n");
+
+    if (openwithgrandchild("(trap '' TERM; exec sleep 30) & echo $!; wait", MYPOPEN_SETPGRP,
+                           &grandchild) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    errno = 0;
+
+    if (mypclose_timeout(fp[0], 100, NULL, 0, NULL) != -1 || errno != ETIMEDOUT)
+    {
+        FAIL(MANDATORY);
+    }
+
+    (void) alarm(0);
+
+    fp[0] = NULL;
+
+    if (!waitgone(grandchild, 1000))
+    {
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 29
+ *
+ * Call mypopen_ex() with MYPOPEN_SUBREAPER and a shell that exits while
+ * a background grandchild keeps running. - mypclose() must return the
+ * exit status of the shell, and the grandchild must have been killed and
+ * reaped by the caller, so no process is left behind.
+ *
+ * \return Nothing
+ */
+void mypopentest29(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    pid_t grandchild = -1;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    (void) alarm(4);
+
+    TRACE0("Doing mypopen_ex(\"sleep 30 & echo $!\") with MYPOPEN_SUBREAPER ...\n");
+
+    if (openwithgrandchild("sleep 30 & echo $!", MYPOPEN_SUBREAPER, &grandchild) == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (mypclose(fp[0]) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    (void) alarm(0);
 
-    (void) alarm(5);
+    fp[0] = NULL;
 
-    TRACE0("Trying mypclose(bogusreadfp) ...\n");
+    TRACE0("Checking that grandchild %ld has been reaped ...\n", (long) grandchild);
+
+    if (kill(grandchild, 0) != -1 || errno != ESRCH)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (waitpid(-1, NULL, WNOHANG) != -1 || errno != ECHILD)
+    {
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 30
+ *
+ * Check the counters of mypstats_snapshot(): a child of mypopen() counts
+ * as spawned and active, as a zombie once it has exited and as active no
+ * more after mypclose(); the bytes collected by mypdrain() and given as
+ * stdin_data are counted, the bytes read from a stream are not; a missing program counts as a spawn failure
+ * with ENOENT; a close that has to escalate counts as a close timeout;
+ * and a mypopen() failing in fdopen() leaves no active child behind.
+ *
+ * \return Nothing
+ */
+void mypopentest30(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    const struct timespec exittime = { 0, 200 * 1000 * 1000L };
+    char *argv[] = { "popentest-no-such-program", NULL };
+    char buffer[MAXLINE];
+    struct mypdrain_stats drained;
+    struct mypstats before, after;
+    struct mypopen_attr attr;
+
+    ENTER();
+
+    setTestName(testname, testdescription);
+
+    initresources();
+
+    (void) alarm(4);
+
+    mypstats_snapshot(&before);
+
+    TRACE0("Doing mypopen(\"echo '%s'\", \"r\") ...\n", LINE1);
+
+    if ((fp[0] = MYCHECKEDPOPEN("echo '" LINE1 "'", "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    (void) nanosleep(&exittime, NULL);
+
+    mypstats_snapshot(&after);
+
+    if (after.spawns != before.spawns + 1 || after.active != before.active + 1 ||
+        after.zombies != 1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (mypdrain(fp[0], &drained) == -1 || mypclose(fp[0]) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    mypstats_snapshot(&after);
+
+    if (after.active != before.active || after.zombies != 0 ||
+        after.bytes_collected != before.bytes_collected + sizeof(LINE1))
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypopen(\"echo '%s'\", \"r\") and reading the line with fgets() ...\n", LINE1);
+
+    before = after;
+
+    if ((fp[0] = MYCHECKEDPOPEN("echo '" LINE1 "'", "r")) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    mypstats_snapshot(&after);
+
+    if (after.bytes_collected != before.bytes_collected)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypopen_ex() with stdin_data and with a missing program ...\n");
+
+    mypopen_attr_init(&attr);
+    attr.stdin_data = LINE2;
+    attr.stdin_size = sizeof(LINE2) - 1;
+
+    if ((fp[0] = mypopen_ex("cat > /dev/null", "r", &attr)) == NULL || mypclose(fp[0]) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    mypopen_attr_init(&attr);
+    attr.argv = argv;
 
     errno = 0;
 
-    if ((mypclose(bogusreadfp) != -1)  || (errno != EINVAL))
+    if ((fp[0] = mypopen_ex(argv[0], "r", &attr)) != NULL || errno != ENOENT)
     {
-        bogusreadfp = NULL; /* myclose has closed this one */
-        alarmoccurred = 0;
+        FAIL(MANDATORY);
+    }
+
+    mypstats_snapshot(&after);
 
+    if (after.bytes_stdin != before.bytes_stdin + sizeof(LINE2) - 1 ||
+        after.spawn_failures != before.spawn_failures + 1 ||
+        after.spawn_errors[ENOENT] != before.spawn_errors[ENOENT] + 1)
+    {
         FAIL(MANDATORY);
     }
 
-    /*
-     * cancel alarm
-     */
-    (void) alarm(0);
+    TRACE0("Doing mypclose_timeout() on a child that does not exit ...\n");
 
-    TRACE0("Checking whether mypclose() timed out ...\n");
+    if ((fp[0] = MYCHECKEDPOPEN("exec sleep 5", "r")) == NULL ||
+        mypclose_timeout(fp[0], 50, NULL, 0, NULL) != -1)
+    {
+        FAIL(MANDATORY);
+    }
 
-    if (alarmoccurred == 1)
+    fp[0] = NULL;
+
+    mypstats_snapshot(&after);
+
+    if (after.close_timeouts != before.close_timeouts + 1 || after.active != before.active)
     {
-        alarmoccurred = 0;
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypopen(\"exec sleep 5\", \"r\") with malloc() failing ...\n");
+
+    let_malloc_fail = 1;
+
+    fp[0] = MYCHECKEDPOPEN("exec sleep 5", "r");
+
+    let_malloc_fail = 0;
+
+    if (fp[0] != NULL)
+    {
+        FAIL(MANDATORY);
+    }
 
+    mypstats_snapshot(&after);
+
+    if (after.active != before.active)
+    {
         FAIL(MANDATORY);
     }
 
+    (void) alarm(0);
+
     freeresources();
 
     PASS();
@@ -842,69 +4090,246 @@ void mypopentest02(
 }
 
 /**
- * \brief Test 03
+ * \brief Test 31
  *
- * Try to call mypclose() with NULL as file pointer. - This should yield
- * an error and errno should be set to EINVAL.
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Build an environment with mypenv_init() from two variables, replace
+ * one, add one and remove one, and check mypenv_get() and the array of
+ * mypenv_envp(), which has to be rebuilt after every change and must be
+ * what a child created with it sees. - Replace a large variable often
+ * enough to fill the arena many times, which must be compacted instead of
+ * grown. - Let the second malloc() of mypenv_init() fail, after which
+ * mypenv_destroy() must still be safe.
  *
  * \return Nothing
  */
-void mypopentest03(
-    const char * const testname, 
+void mypopentest31(
+    const char * const testname,
     const char * const testdescription
     )
 {
+    char * const base[] = { "POPENTEST_A=1", "POPENTEST_B=2", NULL };
+    char value[1000];
+    char buffer[MAXLINE];
+    struct mypopen_attr attr;
+    struct mypenv env;
+    char * const *envp;
+    int i;
+
     ENTER();
 
+    setTestName(testname, testdescription);
+
     initresources();
 
+    TRACE0("Setting and removing variables ...\n");
+
+    if (mypenv_init(&env, base) == -1)
+    {
+        bailout("Cannot initialize the environment");
+    }
+
+    if ((envp = mypenv_envp(&env)) == NULL || strcmp(envp[0], base[0]) != 0 ||
+        strcmp(envp[1], base[1]) != 0 || envp[2] != NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (mypenv_set(&env, "POPENTEST_A", "3") == -1 || mypenv_set(&env, "POPENTEST_C", "4") == -1 ||
+        mypenv_unset(&env, "POPENTEST_B") == -1 || mypenv_unset(&env, "POPENTEST_D") == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if (strcmp(mypenv_get(&env, "POPENTEST_A"), "3") != 0 ||
+        mypenv_get(&env, "POPENTEST_B") != NULL ||
+        strcmp(mypenv_get(&env, "POPENTEST_C"), "4") != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if ((envp = mypenv_envp(&env)) == NULL || strcmp(envp[0], "POPENTEST_A=3") != 0 ||
+        strcmp(envp[1], "POPENTEST_C=4") != 0 || envp[2] != NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing mypopen_ex(\"echo $POPENTEST_A $POPENTEST_B $POPENTEST_C\") ...\n");
+
+    mypopen_attr_init(&attr);
+    attr.envp = envp;
+
+    if ((fp[0] = mypopen_ex("echo $POPENTEST_A $POPENTEST_B $POPENTEST_C", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    if (strcmp(buffer, "3 4\n") != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Replacing a large variable 100 times ...\n");
+
+    memset(value, 'x', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+
+    for (i = 0; i < 100; i++)
+    {
+        value[0] = (char) ('a' + i % 26);
+
+        if (mypenv_set(&env, "POPENTEST_BIG", value) == -1)
+        {
+            FAIL(MANDATORY);
+        }
+    }
+
+    if (strcmp(mypenv_get(&env, "POPENTEST_BIG"), value) != 0 || env.arena_size > 8192 ||
+        strcmp(mypenv_get(&env, "POPENTEST_A"), "3") != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if ((envp = mypenv_envp(&env)) == NULL || envp[2] == NULL ||
+        strncmp(envp[2], "POPENTEST_BIG=", 14) != 0 || strcmp(envp[2] + 14, value) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    mypenv_destroy(&env);
+
+    TRACE0("Doing mypenv_init() with its second malloc() failing ...\n");
+
+    mallocs_before_failure = 1;
+    let_malloc_fail = 1;
+
+    i = mypenv_init(&env, base);
+
+    let_malloc_fail = 0;
+    mallocs_before_failure = 0;
+
+    if (i != -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    mypenv_destroy(&env);
+
+    freeresources();
+
+    PASS();
+
+    EXIT();
+}
+
+/**
+ * \brief Test 32
+ *
+ * Create a cgroup below the one of the test and call mypopen_ex() with
+ * it as cgroup; the child must find itself in that cgroup in
+ * /proc/self/cgroup. - Call mypopen_ex() with a cgroup that does not
+ * exist, which has to fail with ENOENT. - Call mypopen_ex() with /tmp,
+ * not a cgroup, which has to fail as well. The test is skipped if no
+ * cgroup2 file system is mounted or the cgroup cannot be created (not
+ * delegated).
+ *
+ * \return Nothing
+ */
+void mypopentest32(
+    const char * const testname,
+    const char * const testdescription
+    )
+{
+    struct mypopen_attr attr;
+    char parent[PATH_MAX];
+    char group[PATH_MAX + 32];
+    char expected[PATH_MAX + 32];
+    char buffer[PATH_MAX + 32];
+    int saved_errno;
+
+    ENTER();
+
     setTestName(testname, testdescription);
 
-    TRACE0("Trying mypopen(\"cat\", \"w\") ...\n");
+    initresources();
 
-    if ((fp[0] = MYCHECKEDPOPEN("cat", "w")) == NULL)
+    if (owncgroup(parent, sizeof(parent)) == -1)
+    {
+        TRACE0("No cgroup2 file system mounted, skipping ...\n");
+
+        freeresources();
+
+        PASS();
+    }
+
+    (void) snprintf(group, sizeof(group), "%s/popentest-%ld", parent, (long) getpid());
+
+    if (mkdir(group, 0755) == -1)
+    {
+        TRACE0("Cannot create cgroup %s (%s), skipping ...\n", group, strerror(errno));
+
+        freeresources();
+
+        PASS();
+    }
+
+    (void) alarm(4);
+
+    TRACE0("Doing mypopen_ex(\"grep ^0:: /proc/self/cgroup\") with cgroup %s ...\n", group);
+
+    mypopen_attr_init(&attr);
+    attr.cgroup = group;
+
+    if ((fp[0] = mypopen_ex("grep ^0:: /proc/self/cgroup", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL)
     {
+        saved_errno = errno;
+        (void) rmdir(group);
+        errno = saved_errno;
         FAIL(MANDATORY);
     }
 
-    /*
-     * take caution here, since this might hang if passed a bogus file
-     * pointer (i.e., one not obtained via mypopen())
-     */
+    if (mypclose(fp[0]) != 0)
+    {
+        fp[0] = NULL;
+        (void) rmdir(group);
+        FAIL(MANDATORY);
+    }
 
-    /*
-     * store fp in global var, so that signal handler can close it upon
-     * alarm
-     */
-    fptoclose = (volatile FILE **) &(fp[0]);
+    fp[0] = NULL;
 
-    (void) alarm(5);
+    (void) alarm(0);
 
-    TRACE0("Trying mypclose(NULL) ...\n");
+    (void) rmdir(group);
 
-    errno = 0;
+    /* the path in /proc/self/cgroup is relative to the root of the hierarchy */
+    (void) snprintf(expected, sizeof(expected), "/popentest-%ld\n", (long) getpid());
 
-    if ((mypclose(NULL) != -1)  || (errno != EINVAL))
+    TRACE0("Checking that the child ran in it: %s", buffer);
+
+    if (strncmp(buffer, "0::", 3) != 0 || strlen(buffer) < strlen(expected) ||
+        strcmp(buffer + strlen(buffer) - strlen(expected), expected) != 0)
     {
-        bogusreadfp = NULL; /* myclose has closed this one */
-        alarmoccurred = 0;
+        FAIL(MANDATORY);
+    }
 
-        FAIL(OPTIONAL);
+    TRACE0("Doing mypopen_ex(\"true\") with cgroup %s removed ...\n", group);
+
+    if ((fp[0] = mypopen_ex("true", "r", &attr)) != NULL || errno != ENOENT)
+    {
+        FAIL(MANDATORY);
     }
 
-    /*
-     * cancel alarm
-     */
-    (void) alarm(0);
+    TRACE0("Doing mypopen_ex(\"true\") with cgroup /tmp ...\n");
 
-    TRACE0("Checking whether mypclose() timed out ...\n");
+    attr.cgroup = "/tmp";
 
-    if (alarmoccurred == 1)
-    {
-        alarmoccurred = 0;
+    errno = 0;
 
+    if ((fp[0] = mypopen_ex("true", "r", &attr)) != NULL || errno == 0)
+    {
         FAIL(MANDATORY);
     }
 
@@ -916,83 +4341,164 @@ void mypopentest03(
 }
 
 /**
- * \brief Test 04
+ * \brief Test 33
  *
- * Try to call mypopen() with a type parameter of "x" -  This should
- * yield an error and errno should be set to EINVAL.
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Enable the output cache in memory and in a directory and read the
+ * output of a command larger than a pipe with read() on its file
+ * descriptor, 7 bytes at a time. - Read it again from the memory and,
+ * with only the directory enabled, from the directory, once with read()
+ * of 7 bytes and once with fread() of 1 byte. - Every replay must return
+ * exactly the bytes of the command, which must have run once only.
  *
  * \return Nothing
  */
-void mypopentest04(
-    const char * const testname, 
+void mypopentest33(
+    const char * const testname,
     const char * const testdescription
     )
 {
+    static char expected[256 * 1024];
+    static char replayed[256 * 1024];
+    char counter[] = "/tmp/popen.XXXXXX";
+    char directory[] = "/tmp/popen.XXXXXX";
+    char command[MAXLINE];
+    ssize_t expectedsize, replayedsize;
+    int fd;
+
     ENTER();
 
     setTestName(testname, testdescription);
 
     initresources();
 
-    TRACE0("Trying mypopen(\"cat\", \"x\") ...\n");
+    if ((fd = mkstemp(counter)) == -1)
+    {
+        bailout("Cannot create temporary file");
+    }
+    (void) close(fd);
 
-    errno = 0;
+    if (mkdtemp(directory) == NULL)
+    {
+        bailout("Cannot create temporary directory");
+    }
 
-    if (((fp[0] = MYCHECKEDPOPEN("cat", "x")) != NULL) || (errno != EINVAL))
+    countedcommand(command, sizeof(command), counter, "seq 1 30000");
+
+    if (mypcache_enable(1024 * 1024, -1, 0) == -1 ||
+        mypcache_enable_dir(directory, 1024 * 1024, 0) == -1)
+    {
+        bailout("Cannot enable the cache");
+    }
+
+    (void) alarm(5);
+
+    TRACE0("Doing mypopen(\"%s\", \"r\") and reading 7 bytes at a time ...\n", command);
+
+    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
     {
         FAIL(MANDATORY);
     }
 
-    freeresources();
+    if ((expectedsize = readinpieces(fp[0], expected, sizeof(expected), 7)) <= 65536 ||
+        mypclose(fp[0]) != 0)
+    {
+        FAIL(MANDATORY);
+    }
 
-    PASS();
+    fp[0] = NULL;
 
-    EXIT();
-}
+    TRACE0("Replaying %ld bytes from memory 7 bytes at a time ...\n", (long) expectedsize);
 
-/**
- * \brief Test 05
- *
- * Try to call mypopen() with a type parameters "rotz" and "what the ..."
- * (i.e., something that start with 'r' and 'w' but is actually a string
- * different from "r" and "w". - This should yield and error and errno
- * should be set to EINVAL.
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
- *
- * \return Nothing
- */
-void mypopentest05(
-    const char * const testname, 
-    const char * const testdescription
-    )
-{
-    ENTER();
+    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
 
-    setTestName(testname, testdescription);
+    replayedsize = readinpieces(fp[0], replayed, sizeof(replayed), 7);
 
-    initresources();
+    if (mypclose(fp[0]) != 0 || replayedsize != expectedsize ||
+        memcmp(replayed, expected, (size_t) expectedsize) != 0)
+    {
+        fp[0] = NULL;
+        FAIL(MANDATORY);
+    }
 
-    TRACE0("Trying mypopen(\"ls\", \"rotz\") ...\n");
+    fp[0] = NULL;
 
-    errno = 0;
+    TRACE0("Replaying from memory 1 byte at a time with fread() ...\n");
 
-    if (((fp[0] = MYCHECKEDPOPEN("ls", "rotz")) != NULL) || (errno != EINVAL))
+    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE0("Trying mypopen(\"cat\", \"what the ...\") ...\n");
+    replayedsize = readinpieces(fp[0], replayed, sizeof(replayed), 0);
 
-    errno = 0;
+    if (mypclose(fp[0]) != 0 || replayedsize != expectedsize ||
+        memcmp(replayed, expected, (size_t) expectedsize) != 0)
+    {
+        fp[0] = NULL;
+        FAIL(MANDATORY);
+    }
 
-    if (((fp[1] = MYCHECKEDPOPEN("cat", "what the ....")) != NULL) || (errno != EINVAL))
+    fp[0] = NULL;
+
+    TRACE0("Replaying from the directory 7 bytes at a time ...\n");
+
+    mypcache_disable();
+
+    if (mypcache_enable_dir(directory, 1024 * 1024, 0) == -1)
+    {
+        bailout("Cannot enable the cache");
+    }
+
+    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
     {
         FAIL(MANDATORY);
     }
 
+    replayedsize = readinpieces(fp[0], replayed, sizeof(replayed), 7);
+
+    if (mypclose(fp[0]) != 0 || replayedsize != expectedsize ||
+        memcmp(replayed, expected, (size_t) expectedsize) != 0)
+    {
+        fp[0] = NULL;
+        FAIL(MANDATORY);
+    }
+
+    fp[0] = NULL;
+
+    TRACE0("Replaying from the directory 1 byte at a time with fread() ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    replayedsize = readinpieces(fp[0], replayed, sizeof(replayed), 0);
+
+    if (mypclose(fp[0]) != 0 || replayedsize != expectedsize ||
+        memcmp(replayed, expected, (size_t) expectedsize) != 0)
+    {
+        fp[0] = NULL;
+        FAIL(MANDATORY);
+    }
+
+    (void) alarm(0);
+
+    fp[0] = NULL;
+
+    if (countlines(counter) != 1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    mypcache_disable();
+
+    removedirectory(directory);
+
+    (void) unlink(counter);
+
     freeresources();
 
     PASS();
@@ -1001,84 +4507,125 @@ void mypopentest05(
 }
 
 /**
- * \brief Test 06
+ * \brief Test 34
  *
- * Call mypopen() with a command that requires input. Check if the created
- * child process is really there.
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
- * Call mypclose() and check if the exit status of the child process has
- * been properly consumed via wait() or waitpid().
+ * Run a program by name without a shell with PATH set to an empty
+ * directory, which has to fail with ENOENT in the parent. - Install the
+ * program but restore the mtime of the directory: the failed lookup is
+ * cached for that state of the directory, so it must still fail. - Change
+ * the mtime, the program must be found now. - Replace the program with
+ * another file, which must be run instead of the cached one. - Set PATH
+ * to another directory holding another program of the same name, which
+ * must be run.
  *
  * \return Nothing
  */
-void mypopentest06(
-    const char * const testname, 
+void mypopentest34(
+    const char * const testname,
     const char * const testdescription
     )
 {
-    char popencommand[] = POPENCOMMAND PIDPATTERN;
-    char findprocesscommand[] = FINDPROCESSCOMMAND POPENCOMMAND PIDPATTERN;
+    const char name[] = "popentest-program";
+    char first[] = "/tmp/popen.XXXXXX";
+    char second[] = "/tmp/popen.XXXXXX";
+    char buffer[MAXLINE];
+    struct timespec times[2];
+    struct stat st;
 
     ENTER();
 
     setTestName(testname, testdescription);
 
-    (void) snprintf(
-        popencommand,
-        sizeof(popencommand),
-        POPENCOMMAND,
-        getpid()
-        );
+    initresources();
 
-    (void) snprintf(
-        findprocesscommand,
-        sizeof(findprocesscommand),
-        FINDPROCESSCOMMAND,
-        popencommand
-        );
+    if (mkdtemp(first) == NULL || mkdtemp(second) == NULL)
+    {
+        bailout("Cannot create temporary directory");
+    }
 
-    initresources();
+    if (setenv("PATH", first, 1) == -1)
+    {
+        bailout("Cannot set PATH");
+    }
 
-    TRACE0("Trying mypopen(\"%s\", \"w\") ...\n", popencommand);
+    (void) alarm(4);
 
-    if ((fp[0] = mypopen(popencommand, "w")) == NULL)
+    TRACE0("Running %s with PATH=%s ...\n", name, first);
+
+    errno = 0;
+
+    if (runprogram(name, buffer, sizeof(buffer)) != -1 || errno != ENOENT)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE0("Doing system(\"%s\") ...\n", findprocesscommand);
+    TRACE0("Installing %s keeping the mtime of %s ...\n", name, first);
 
+    if (stat(first, &st) == -1)
+    {
+        bailout("Cannot stat temporary directory");
+    }
 
-    blockonwrite(fp[0]);
-    /* sleep(SLEEPTIME); */
+    times[0] = st.st_atim;
+    times[1] = st.st_mtim;
 
-    /* check if child is there and living - must be there */
-    if (system(findprocesscommand) != 0)
+    if (writeprogram(first, name, "one") == -1 || utimensat(AT_FDCWD, first, times, 0) == -1)
+    {
+        bailout("Cannot install program");
+    }
+
+    errno = 0;
+
+    if (runprogram(name, buffer, sizeof(buffer)) != -1 || errno != ENOENT)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypclose(fp[0]) ...\n");
+    TRACE0("Changing the mtime of %s ...\n", first);
 
-    if (mypclose(fp[0]) == -1)
+    ++times[1].tv_sec;
+
+    if (utimensat(AT_FDCWD, first, times, 0) == -1)
+    {
+        bailout("Cannot change the mtime of the temporary directory");
+    }
+
+    if (runprogram(name, buffer, sizeof(buffer)) == -1 || strcmp(buffer, "one\n") != 0)
     {
         FAIL(MANDATORY);
     }
 
-    fp[0] = NULL;
+    TRACE0("Replacing %s ...\n", name);
 
-    TRACE0("Doing system(\"%s\") ...\n", findprocesscommand);
+    if (writeprogram(first, name, "two") == -1)
+    {
+        bailout("Cannot install program");
+    }
 
+    if (runprogram(name, buffer, sizeof(buffer)) == -1 || strcmp(buffer, "two\n") != 0)
+    {
+        FAIL(MANDATORY);
+    }
 
-    /*  sleep(SLEEPTIME); */
+    TRACE0("Running %s with PATH=%s ...\n", name, second);
 
-    /* check if child is there and living - must NOT be there*/
-    if (system(findprocesscommand) == 0)
+    if (writeprogram(second, name, "three") == -1 || setenv("PATH", second, 1) == -1)
+    {
+        bailout("Cannot install program");
+    }
+
+    if (runprogram(name, buffer, sizeof(buffer)) == -1 || strcmp(buffer, "three\n") != 0)
     {
         FAIL(MANDATORY);
     }
 
+    (void) alarm(0);
+
+    mypopen_forget_programs();
+
+    removedirectory(first);
+    removedirectory(second);
+
     freeresources();
 
     PASS();
@@ -1087,105 +4634,139 @@ void mypopentest06(
 }
 
 /**
- * \brief Test 07
+ * \brief Test 35
  *
- * Call mypopen(), fork(), mypclose() - forked child process must
- * still be there
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Check the XXH64 hash (seed 0) of mypdrain() against the reference
+ * values for the empty input, 1 byte and 43 bytes. - Read lines of every
+ * length from 1 to 71 bytes and a last line without newline from a file
+ * with mypline_next() and a buffer of 333 bytes, so the lines start at
+ * every alignment: every line must be returned as written. - Count the
+ * newlines of prefixes of odd lengths of the file with mypdrain(), which
+ * must match a count one byte at a time. The vector scanners hand their
+ * tails to the narrower ones, so this covers AVX2, SSE2 and scalar code.
  *
  * \return Nothing
  */
-void mypopentest07(
-    const char * const testname, 
+void mypopentest35(
+    const char * const testname,
     const char * const testdescription
     )
 {
-    char popencommand[] = POPENCOMMAND PIDPATTERN;
-    char findprocesscommand[] = FINDPROCESSCOMMAND POPENCOMMAND PIDPATTERN;
+    static const struct
+    {
+        const char *command;
+        uint64_t bytes;
+        uint64_t hash;
+    } vectors[] =
+    {
+        { "printf ''", 0, 0xEF46DB3751D8E999ULL },
+        { "printf a", 1, 0xD24EC4F1A98C6E5BULL },
+        { "printf '%s' 'The quick brown fox jumps over the lazy dog'", 43, 0x0B242D361FDA71BCULL },
+    };
+    static const size_t prefixes[] = { 1, 15, 17, 31, 33, 63, 65, 97, 4097, 0 };
+    static char data[64 * 1024];
+    char path[] = "/tmp/popen.XXXXXX";
+    char command[MAXLINE];
+    struct mypdrain_stats drained;
+    struct mypline_reader reader;
+    const char *line;
+    size_t size = 0, length, i, j;
+    uint64_t lines;
+    ssize_t n;
+    int fd;
 
     ENTER();
 
     setTestName(testname, testdescription);
 
-    (void) snprintf(
-        popencommand,
-        sizeof(popencommand),
-        POPENCOMMAND,
-        getpid()
-        );
-
-    (void) snprintf(
-        findprocesscommand,
-        sizeof(findprocesscommand),
-        FINDPROCESSCOMMAND,
-        popencommand
-        );
-
     initresources();
 
-    TRACE0("Trying mypopen(\"%s\", \"w\") ...\n", popencommand);
+    (void) alarm(4);
 
-    if ((fp[0] = MYCHECKEDPOPEN(popencommand, "w")) == NULL)
+    for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
     {
-        FAIL(MANDATORY);
-    }
+        TRACE0("Doing mypdrain() on the output of \"%s\" ...\n", vectors[i].command);
 
-    TRACE0("Creating dummy child ...\n");
+        if (draincommand(vectors[i].command, &drained) == -1 ||
+            drained.bytes != vectors[i].bytes || drained.hash != vectors[i].hash)
+        {
+            FAIL(MANDATORY);
+        }
+    }
 
-    /* create dummy child */
-    switch (dummychildpid = fork())
+    /* lines of 1 to 71 bytes including the newline, 71 is prime to the vector widths */
+    for (i = 0; size + 71 + 37 <= sizeof(data); i++)
     {
-    case -1:
-        bailout("Cannot create child");
-        break;
-
-    case 0:
-        exit(EXIT_SUCCESS); /* be a zombie */
-        break;
-
-    default:
-        break;
+        length = i % 71;
+        memset(data + size, 'a' + (int) (i % 26), length);
+        data[size + length] = '\n';
+        size += length + 1;
     }
 
-    TRACE0("Doing system(\"%s\") ...\n", findprocesscommand);
+    memset(data + size, 'z', 37);
+    size += 37;
 
-    blockonwrite(fp[0]);
-    /*  sleep(SLEEPTIME); */
+    if ((fd = mkstemp(path)) == -1)
+    {
+        bailout("Cannot create temporary file");
+    }
 
-    /* check if child is there and living - must be there */
-    if (system(findprocesscommand) != 0)
+    if (write(fd, data, size) != (ssize_t) size || lseek(fd, 0, SEEK_SET) == -1)
     {
-        FAIL(MANDATORY);
+        bailout("Cannot write temporary file");
     }
 
-    TRACE0("Doing mypclose(fp[0]) ...\n");
+    TRACE0("Doing mypline_next() on %lu bytes of lines ...\n", (unsigned long) size);
 
-    if (mypclose(fp[0]) == -1)
+    if (mypline_init(&reader, fd, 333) == -1)
     {
         FAIL(MANDATORY);
     }
 
-    fp[0] = NULL;
+    for (i = 0, j = 0; (n = mypline_next(&reader, &line)) > 0; i++, j += (size_t) n)
+    {
+        length = j + 37 == size ? 37 : i % 71 + 1;
 
-    TRACE0("Doing system(\"%s\") ...\n", findprocesscommand);
+        if ((size_t) n != length || memcmp(line, data + j, length) != 0)
+        {
+            mypline_destroy(&reader);
+            FAIL(MANDATORY);
+        }
+    }
 
-    /* sleep(SLEEPTIME); */
+    mypline_destroy(&reader);
 
-    /* check if child is there and living - must NOT be there*/
-    if (system(findprocesscommand) == 0)
+    (void) close(fd);
+
+    if (n == -1 || j != size)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE0("Checking if dummy child is still there (as a zombie) ...\n");
-
-    /* check if other child is still there (as a zombie) */
-    if (kill(dummychildpid, 0) == -1)
+    for (i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++)
     {
-        FAIL(MANDATORY);
+        length = prefixes[i] != 0 ? prefixes[i] : size;
+
+        for (j = 0, lines = 0; j < length; j++)
+        {
+            lines += data[j] == '\n';
+        }
+
+        (void) snprintf(command, sizeof(command), "head -c %lu %s", (unsigned long) length, path);
+
+        TRACE0("Doing mypdrain() on the output of \"%s\" ...\n", command);
+
+        if (draincommand(command, &drained) == -1 || drained.bytes != length ||
+            drained.lines != lines)
+        {
+            FAIL(MANDATORY);
+        }
     }
 
+    (void) alarm(0);
+
+    (void) unlink(path);
+
     freeresources();
 
     PASS();
@@ -1194,24 +4775,38 @@ void mypopentest07(
 }
 
 /**
- * \brief Test 08
+ * \brief Test 36
  *
- * Call mypopen("echo 'This is a test.'; sleep 1; echo 'Second line
- * for test.'", "r"); read from file pointer; check if we read the two
- * lines; call mypclose()
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Call mypbatch() with a slow, a failing, a missing (NULL) and another
+ * command. - The results must be stored in the order of the commands,
+ * with the output and exit status of each and a wstatus of -1 and EINVAL
+ * for the command that could not be started, while the callback sees
+ * them as they complete. - Run six commands logging their start and end
+ * with a concurrency of two: no more than two must run at the same time.
  *
  * \return Nothing
  */
-void mypopentest08(
-    const char * const testname, 
+void mypopentest36(
+    const char * const testname,
     const char * const testdescription
     )
 {
-    char buffer[MAXLINE];
-
-    const char * const popen_cmd = "echo '" LINE1 "'; sleep 1; echo '" LINE2 "'";
+    const char * const commands[] =
+    {
+        "sleep 0.3; echo zero",
+        "echo one; exit 3",
+        NULL,
+        "sleep 0.1; echo three",
+    };
+    const size_t count = sizeof(commands) / sizeof(commands[0]);
+    struct mypbatch_result results[sizeof(commands) / sizeof(commands[0])];
+    size_t order[sizeof(commands) / sizeof(commands[0]) + 1] = { 0 };
+    char log[] = "/tmp/popen.XXXXXX";
+    char command[MAXLINE];
+    const char *bounded[6];
+    struct timespec start;
+    size_t i;
+    int fd;
 
     ENTER();
 
@@ -1219,62 +4814,68 @@ void mypopentest08(
 
     initresources();
 
-    TRACE0("Doing mypopen(\"%s\") ...\n", popen_cmd);
+    (void) alarm(4);
 
-    if (
-        (fp[0] = MYCHECKEDPOPEN(
-            popen_cmd,
-            "r"
-            )
-            ) == NULL
-        )
+    TRACE0("Doing mypbatch() on %lu commands ...\n", (unsigned long) count);
+
+    if (mypbatch(commands, count, 4, NULL, results, recordbatch, order) == -1)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE("Trying to read from pipe ...\n");
-
-    if (fgets(buffer, sizeof(buffer), fp[0]) == NULL)
+    if (results[0].output == NULL || strcmp(results[0].output, "zero\n") != 0 ||
+        results[0].wstatus != 0 || results[1].output == NULL ||
+        strcmp(results[1].output, "one\n") != 0 || !WIFEXITED(results[1].wstatus) ||
+        WEXITSTATUS(results[1].wstatus) != 3 || results[2].wstatus != -1 ||
+        results[2].error != EINVAL || results[3].output == NULL ||
+        strcmp(results[3].output, "three\n") != 0 || results[3].wstatus != 0)
     {
+        mypbatch_free(results, count);
         FAIL(MANDATORY);
     }
 
-    TRACE("Comparing line read with expected result ...\n");
+    mypbatch_free(results, count);
 
-    if (strcmp(buffer, LINE1 "\n") != 0)
+    TRACE0("Checking the order of the callbacks ...\n");
+
+    /* the command that cannot be started is reported first, the slowest last */
+    if (order[0] != count || order[1] != 2 || order[count] != 0)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE("Trying to read from pipe ...\n");
-
-    if (fgets(buffer, sizeof(buffer), fp[0]) == NULL)
+    if ((fd = mkstemp(log)) == -1)
     {
-        FAIL(MANDATORY);
+        bailout("Cannot create temporary file");
     }
+    (void) close(fd);
 
-    TRACE("Comparing line read with expected result ...\n");
+    (void) snprintf(command, sizeof(command), "echo + >> %s; sleep 0.1; echo - >> %s", log, log);
 
-    if (strcmp(buffer, LINE2 "\n") != 0)
+    for (i = 0; i < sizeof(bounded) / sizeof(bounded[0]); i++)
     {
-        FAIL(MANDATORY);
+        bounded[i] = command;
     }
 
-    TRACE("Trying to read from pipe - should yield EOF ...\n");
+    TRACE0("Doing mypbatch() on 6 times \"%s\" with a concurrency of 2 ...\n", command);
 
-    if ((fgets(buffer, sizeof(buffer), fp[0]) != NULL) || (!feof(fp[0])))
+    (void) clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (mypbatch(bounded, sizeof(bounded) / sizeof(bounded[0]), 2, NULL, NULL, NULL, NULL) == -1)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypclose(fp[0]) ...\n");
+    (void) alarm(0);
 
-    if (mypclose(fp[0]) == -1)
+    TRACE0("Checking that two of them ran at a time ...\n");
+
+    if (maxrunning(log) != 2 || countlines(log) != 12 || elapsedms(&start) < 300)
     {
         FAIL(MANDATORY);
     }
 
-    fp[0] = NULL;
+    (void) unlink(log);
 
     freeresources();
 
@@ -1284,24 +4885,26 @@ void mypopentest08(
 }
 
 /**
- * \brief Test 09
+ * \brief Test 37
  *
- * Call mypopen("cat > some_temp_file", "w"); write to file pointer;
- * check if some_temp_file contains the respective text.
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Call mypcapture() for output larger than a pipe, which must be
+ * captured completely, and for a command without output. - Capture a
+ * command exiting with 5 and one killed by a signal, whose output must be
+ * available as well, with 5 returned and -1 and ECHILD respectively. -
+ * Capture while a stream of mypopen() is open, which must not be
+ * affected. - mypcapture_free() must leave an empty output behind.
  *
  * \return Nothing
  */
-void mypopentest09(
-    const char * const testname, 
+void mypopentest37(
+    const char * const testname,
     const char * const testdescription
     )
 {
+    struct mypcapture_output output;
     char buffer[MAXLINE];
-    char tempfilename[] = "/tmp/popen.XXXXXXX";
-    char popencommand[sizeof(tempfilename) + sizeof(POPENCOMMAND2)];
-    int tempfile;
+    size_t lines = 0;
+    size_t i;
 
     ENTER();
 
@@ -1309,104 +4912,94 @@ void mypopentest09(
 
     initresources();
 
-    TRACE0("Getting name of tempfile ...\n");
-
-    tempfile = mkstemp(tempfilename);
-    if (tempfile == -1)
-    {
-        bailout("Cannot create temporary file");
-    }
-
-    (void) snprintf(
-        popencommand,
-        sizeof(popencommand),
-        POPENCOMMAND2,
-        tempfilename
-        );
+    (void) alarm(4);
 
-    TRACE0("Doing mypopen(\"%s\", \"w\") ...\n", popencommand);
+    TRACE0("Doing mypcapture(\"seq 1 100000\") ...\n");
 
-    if ((fp[0] = MYCHECKEDPOPEN(popencommand, "w")) == NULL)
+    if (mypcapture("seq 1 100000", NULL, &output) != 0 || output.wstatus != 0)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE("Trying to write to pipe ...\n");
+    for (i = 0; i < output.size; i++)
+    {
+        lines += output.data[i] == '\n';
+    }
 
-    if (fputs(LINE1 "\n", fp[0]) == EOF)
+    if (output.size != 588895 || lines != 100000 || strncmp(output.data, "1\n", 2) != 0 ||
+        strncmp(output.data + output.size - 7, "100000\n", 7) != 0)
     {
+        mypcapture_free(&output);
         FAIL(MANDATORY);
     }
 
-    TRACE("Trying to write to pipe ...\n");
+    mypcapture_free(&output);
 
-    if (fputs(LINE2 "\n", fp[0]) == EOF)
+    if (output.size != 0 || strcmp(output.data, "") != 0)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypclose(fp[0]) ...\n");
+    TRACE0("Doing mypcapture(\"true\") ...\n");
 
-    if (mypclose(fp[0]) == -1)
+    if (mypcapture("true", NULL, &output) != 0 || output.size != 0)
     {
         FAIL(MANDATORY);
     }
 
-    fp[0] = NULL;
+    mypcapture_free(&output);
 
-    TRACE("Opening temporary file %s ...\n", tempfilename);
+    TRACE0("Doing mypcapture(\"echo partial; exit 5\") ...\n");
 
-    if ((somefp = fopen(tempfilename, "r")) == NULL)
+    if (mypcapture("echo partial; exit 5", NULL, &output) != 5 || output.size != 8 ||
+        strncmp(output.data, "partial\n", 8) != 0 || !WIFEXITED(output.wstatus) ||
+        WEXITSTATUS(output.wstatus) != 5)
     {
-        bailout("Cannot open temporary file for reading");
+        mypcapture_free(&output);
+        FAIL(MANDATORY);
     }
 
-    TRACE("Trying to read a line from file %s ...\n", tempfilename);
+    mypcapture_free(&output);
 
-    if (fgets(buffer, sizeof(buffer), somefp) == NULL)
-    {
-        FAIL(MANDATORY);
-    }
+    TRACE0("Doing mypcapture(\"echo killed; kill -9 $$\") ...\n");
 
-    TRACE("Comparing line read with expected result ...\n");
+    errno = 0;
 
-    if (strcmp(buffer, LINE1 "\n") != 0)
+    if (mypcapture("echo killed; kill -9 $$", NULL, &output) != -1 || errno != ECHILD ||
+        output.size != 7 || strncmp(output.data, "killed\n", 7) != 0 ||
+        !WIFSIGNALED(output.wstatus) || WTERMSIG(output.wstatus) != SIGKILL)
     {
+        mypcapture_free(&output);
         FAIL(MANDATORY);
     }
 
-    TRACE("Trying to read a line from file %s ...\n", tempfilename);
+    mypcapture_free(&output);
 
-    if (fgets(buffer, sizeof(buffer), somefp) == NULL)
+    TRACE0("Doing mypcapture(\"echo inner\") while mypopen(\"echo outer\") is open ...\n");
+
+    if ((fp[0] = MYCHECKEDPOPEN("echo outer", "r")) == NULL)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE("Comparing line read with expected result ...\n");
-
-    if (strcmp(buffer, LINE2 "\n") != 0)
+    if (mypcapture("echo inner", NULL, &output) != 0 || output.size != 6 ||
+        strncmp(output.data, "inner\n", 6) != 0)
     {
+        mypcapture_free(&output);
         FAIL(MANDATORY);
     }
 
-    TRACE("Trying to read from pipe - should yield EOF ...\n");
+    mypcapture_free(&output);
 
-    if ((fgets(buffer, sizeof(buffer), somefp) != NULL) || (!feof(somefp)))
+    if (fgets(buffer, sizeof(buffer), fp[0]) == NULL || strcmp(buffer, "outer\n") != 0 ||
+        mypclose(fp[0]) != 0)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE("Closing temporary file ...\n");
-
-    fclose(somefp);
-    somefp = NULL;
-
-    TRACE("Removing temporary file ...\n");
+    (void) alarm(0);
 
-    if (remove(tempfilename) == -1)
-    {
-        bailout("Cannot remove temporary file");
-    }
+    fp[0] = NULL;
 
     freeresources();
 
@@ -1416,23 +5009,27 @@ void mypopentest09(
 }
 
 /**
- * \brief Test 10
+ * \brief Test 38
  *
- * Set via setrlimit(2) the resource limit for open files
- * (RLIMIT_NOFILE) to 1; call mypopen() and check whether it fails (i.e,
- * return NULL with errno set to EMFILE) due to the failing pipe() call.
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Call mypopen_ex() with 200000 bytes of stdin_data and "wc -c", which
+ * must count all of them, and with empty stdin_data, which must count
+ * none. - Let the child try to overwrite its standard input before
+ * reading it: the data is sealed, so the child must read it unchanged.
+ * - Call mypcapture() with stdin_data and "tr a-z A-Z".
  *
  * \return Nothing
  */
-void mypopentest10(
-    const char * const testname, 
+void mypopentest38(
+    const char * const testname,
     const char * const testdescription
     )
 {
-    struct rlimit openfiles;
-    rlim_t oldlimit;
+    static char data[200000];
+    const char text[] = "hello\nworld\n";
+    struct mypcapture_output output;
+    struct mypopen_attr attr;
+    char buffer[MAXLINE];
+    size_t length;
 
     ENTER();
 
@@ -1440,160 +5037,86 @@ void mypopentest10(
 
     initresources();
 
-    TRACE("Getting resource limit on open files ...\n");
-
-    if (getrlimit(RLIMIT_NOFILE, &openfiles) == -1)
-    {
-        bailout("Cannot obtain current resource limit on open files");
-    }
-
-    /* lower limit to 1 - ensure that next try to open a file fails */
-    oldlimit = openfiles.rlim_cur;
-    openfiles.rlim_cur = 1;
-
-    TRACE0("Lowering resource limit on open files to 1 ...\n");
+    memset(data, 'x', sizeof(data));
 
-    if (setrlimit(RLIMIT_NOFILE, &openfiles) == -1)
-    {
-        bailout("Cannot set current resource limit on open files");
-    }
+    (void) alarm(4);
 
-    /* prepare to restore old limit */
-    openfiles.rlim_cur = oldlimit;
+    TRACE0("Doing mypopen_ex(\"wc -c\") with %lu bytes of stdin_data ...\n",
+           (unsigned long) sizeof(data));
 
-    TRACE0("Trying mypopen(\"ls -al 2> /dev/null\", \"r\") ...\n");
+    mypopen_attr_init(&attr);
+    attr.stdin_data = data;
+    attr.stdin_size = sizeof(data);
 
-    if ((fp[0] = MYCHECKEDPOPEN("ls -al 2> /dev/null", "r")) != NULL)
+    if ((fp[0] = mypopen_ex("wc -c", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
-        TRACE0("Restoring old resource limit on open files ...\n");
-
-        /* restore old limit */
-        if (setrlimit(RLIMIT_NOFILE, &openfiles) == -1)
-        {
-            bailout("Cannot set current resource limit on open files");
-        }
-
         FAIL(MANDATORY);
     }
 
-    TRACE("Restoring old resource limit on open files ...\n");
+    fp[0] = NULL;
 
-    /* restore old limit */
-    if (setrlimit(RLIMIT_NOFILE, &openfiles) == -1)
+    if (atol(buffer) != (long) sizeof(data))
     {
-        bailout("Cannot set current resource limit on open files");
+        FAIL(MANDATORY);
     }
 
-    freeresources();
-
-    PASS();
-
-    EXIT();
-}
-
-/**
- * \brief Test 11
- *
- * Set via setrlimit(2) the resource limit for processes
- * (RLIMIT_NPROC); call mypopen() and check whether it fails with
- * errno set to EAGAIN (due to the failing fork() call).
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
- * Furthermore verify that the pipe is properly closed in case fork() fails.
- * Last but not least call mypclose() and check that it fails as well in
- * order to test is the stored static PID for the child is properly initialized
- * to -1 (the value returned by a failed fork) and/or properly reset to -1
- * upon a failed fork().
- *
- * \return Nothing
- */
-void mypopentest11(
-    const char * const testname, 
-    const char * const testdescription
-    )
-{
-    struct rlimit processes;
-    rlim_t oldlimit;
-    int blah = 0;
-
-    ENTER();
-
-    setTestName(testname, testdescription);
-
-    /* No initresources() here, since we only want stdin, stdout, stderr to be open */
-
-    TRACE("Ensuring that only stdin, stdout, stderr are open ...\n");
+    TRACE0("Doing mypopen_ex(\"wc -c\") with empty stdin_data ...\n");
 
-    /* check that pipe has been properly removed => only stdin, stdout, stderr open */
-    if (!VERIFY_CLOSED_NON_STD_FDS())
-    {
-	bailout("File descriptors other than stdin, stdout, stderr are open");
-    }
-
-    TRACE("Getting resource limit on processes ...\n");
+    attr.stdin_size = 0;
 
-    if (getrlimit(RLIMIT_NPROC, &processes) == -1)
+    if ((fp[0] = mypopen_ex("wc -c", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
-        bailout("Cannot obtain current resource limit on number of processes");
+        FAIL(MANDATORY);
     }
 
-    /* lower limit to 1 - ensure that next try to open a file fails */
-    oldlimit = processes.rlim_cur;
-    processes.rlim_cur = 1;
-
-    TRACE0("Lowering resource limit on processes to 1 ...\n");
+    fp[0] = NULL;
 
-    if (setrlimit(RLIMIT_NPROC, &processes) == -1)
+    if (atol(buffer) != 0)
     {
-        bailout("Cannot set current resource limit on number of processes");
+        FAIL(MANDATORY);
     }
 
-    /* prepare to restore old limit */
-    processes.rlim_cur = oldlimit;
+    TRACE0("Doing mypopen_ex(\"printf overwritten >&0 2>/dev/null; cat\") with stdin_data ...\n");
 
-    TRACE0("Trying mypopen(\"ls -al 2> /dev/null\", \"r\") ...\n");
+    attr.stdin_data = text;
+    attr.stdin_size = strlen(text);
 
-    if ((fp[0] = MYCHECKEDPOPEN("ls -al 2> /dev/null", "r")) != NULL)
+    if ((fp[0] = mypopen_ex("printf overwritten >&0 2>/dev/null; cat", "r", &attr)) == NULL)
     {
-        TRACE("Restoring old resource limit on processes ...\n");
-
-        /* restore old limit */
-        if (setrlimit(RLIMIT_NPROC, &processes) == -1)
-        {
-            bailout("Cannot set current resource limit on number of processes");
-        }
-
         FAIL(MANDATORY);
     }
 
-    TRACE("Restoring old resource limit on processes ...\n");
+    length = fread(buffer, 1, sizeof(buffer), fp[0]);
 
-    /* restore old limit */
-    if (setrlimit(RLIMIT_NPROC, &processes) == -1)
+    if (mypclose(fp[0]) != 0)
     {
-        bailout("Cannot set current resource limit on number of processes");
+        fp[0] = NULL;
+        FAIL(MANDATORY);
     }
 
-    TRACE("Verifying that only stdin, stdout, stderr are open ...\n");
+    fp[0] = NULL;
 
-    /* check that pipe has been properly removed => only stdin, stdout, stderr open */
-    if (!VERIFY_CLOSED_NON_STD_FDS())
+    if (length != strlen(text) || memcmp(buffer, text, length) != 0)
     {
-	FAIL(MANDATORY);
+        FAIL(MANDATORY);
     }
 
-    TRACE("Verifying that mypclose() returns -1 since mypopen() did not succeed ...\n");
+    TRACE0("Doing mypcapture(\"tr a-z A-Z\") with stdin_data ...\n");
 
-    /*
-     * myclose() should signal an error here since mypopen() has not been
-     * called successfully yet
-     */
-    if (((blah = mypclose(fp[0])) != -1) || (errno != ECHILD))
+    if (mypcapture("tr a-z A-Z", &attr, &output) != 0 || output.size != strlen(text) ||
+        memcmp(output.data, "HELLO\nWORLD\n", output.size) != 0)
     {
+        mypcapture_free(&output);
         FAIL(MANDATORY);
     }
 
-    /* No freeresources() here, since we did not call initresources() */
+    mypcapture_free(&output);
+
+    (void) alarm(0);
+
+    freeresources();
 
     PASS();
 
@@ -1601,99 +5124,122 @@ void mypopentest11(
 }
 
 /**
- * \brief Test 12
+ * \brief Test 39
  *
- * Check whether the exit status of the child process is extracted
- * properly with wait() or waitpid().
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Call mypopen_ex() with a temporary directory as cwd and "pwd -P",
+ * which must print it while the working directory of the caller stays
+ * the same, and with a cwd that does not exist, which must let the child
+ * exit with 1. - Run printf with argv holding spaces and shell syntax,
+ * which must reach the program unchanged. - Run "./program" with the
+ * temporary directory as cwd, which must be found relative to it.
  *
  * \return Nothing
  */
-void mypopentest12(
-    const char * const testname, 
+void mypopentest39(
+    const char * const testname,
     const char * const testdescription
     )
 {
+    char *printfargv[] = { "printf", "%s|%s\n", "a  b", "$HOME;*", NULL };
+    char *programargv[] = { "./program", NULL };
+    char directory[] = "/tmp/popen.XXXXXX";
+    char resolved[PATH_MAX];
+    char before[PATH_MAX];
+    char after[PATH_MAX];
+    char buffer[MAXLINE];
+    struct mypopen_attr attr;
+
     ENTER();
 
     setTestName(testname, testdescription);
 
     initresources();
 
-    TRACE0("Doing mypopen(\"exit %d\", \"r\") ...\n", EXPECTED_EXIT_STATUS);
-
-    if ((fp[0] = MYCHECKEDPOPEN("exit " EXPECTED_EXIT_STATUS_STRING, "r")) == NULL)
+    if (mkdtemp(directory) == NULL || realpath(directory, resolved) == NULL ||
+        getcwd(before, sizeof(before)) == NULL)
     {
-        FAIL(MANDATORY);
+        bailout("Cannot create temporary directory");
     }
 
-    TRACE0("Doing mypclose(fp[0]) ...\n");
+    (void) alarm(4);
 
-    if (mypclose(fp[0]) != EXPECTED_EXIT_STATUS)
+    TRACE0("Doing mypopen_ex(\"pwd -P\") with cwd %s ...\n", directory);
+
+    mypopen_attr_init(&attr);
+    attr.cwd = directory;
+
+    if ((fp[0] = mypopen_ex("pwd -P", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
         FAIL(MANDATORY);
     }
 
     fp[0] = NULL;
 
-    freeresources();
+    buffer[strcspn(buffer, "\n")] = '\0';
 
-    PASS();
+    if (strcmp(buffer, resolved) != 0 || getcwd(after, sizeof(after)) == NULL ||
+        strcmp(before, after) != 0)
+    {
+        FAIL(MANDATORY);
+    }
 
-    EXIT();
-}
+    TRACE0("Doing mypopen_ex(\"true\") with cwd /nonexistent ...\n");
 
-/**
- * \brief Test 13
- *
- * Check for correct setting of errno to ECHILD in case the exit status
- * cannot be extracted (i.e., if WIFEXITED() returns FALSE).
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
- *
- * \return Nothing
- */
-void mypopentest13(
-    const char * const testname, 
-    const char * const testdescription
-    )
-{
-    int blah = 0;
-    char command[MAX_COMMAND_LENGTH];
+    attr.cwd = "/nonexistent";
 
-    ENTER();
+    if ((fp[0] = mypopen_ex("true", "r", &attr)) == NULL || mypclose(fp[0]) != 1)
+    {
+        FAIL(MANDATORY);
+    }
 
-    setTestName(testname, testdescription);
+    fp[0] = NULL;
 
-    initresources();
+    TRACE0("Doing mypopen_ex(\"printf\") with argv ...\n");
 
-    snprintf(
-	command,
-	sizeof(command),
-	"./killparent%s %lu",
-	getVerbose() > 0 ? " -v" : "",
-	(unsigned long) getpid()
-	);
+    mypopen_attr_init(&attr);
+    attr.argv = printfargv;
 
-    TRACE0("Doing mypopen(\"%s\", \"r\") ...\n", command);
+    if ((fp[0] = mypopen_ex("printf", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
+    {
+        FAIL(MANDATORY);
+    }
 
-    if ((fp[0] = MYCHECKEDPOPEN(command, "w")) == NULL)
+    fp[0] = NULL;
+
+    if (strcmp(buffer, "a  b|$HOME;*\n") != 0)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypclose(fp[0]) ...\n");
+    TRACE0("Doing mypopen_ex(\"./program\") with argv and cwd %s ...\n", directory);
 
-    errno = 0;
+    if (writeprogram(directory, "program", "relative") == -1)
+    {
+        bailout("Cannot install program");
+    }
 
-    if (((blah = mypclose(fp[0])) != -1) || (errno != ECHILD))
+    attr.argv = programargv;
+    attr.cwd = directory;
+
+    if ((fp[0] = mypopen_ex("./program", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
         FAIL(MANDATORY);
     }
 
+    (void) alarm(0);
+
     fp[0] = NULL;
 
+    if (strcmp(buffer, "relative\n") != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
+    removedirectory(directory);
+
     freeresources();
 
     PASS();
@@ -1702,57 +5248,122 @@ void mypopentest13(
 }
 
 /**
- * \brief Test 14
+ * \brief Test 40
  *
- * Checks if the stored static PID for the child and the stored static
- * file pointer are properly properly reset (or remain set) to invalid values if
- * mypopen() fails somewhere in between (e.g., upon fdopen()). => Let
- * fdopen() fail by installing a malloc_hook(3) that returns NULL and
- * check if mypopen() can be called again ...).
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Compile a template with quoted words, an escaped blank, a quoted
+ * placeholder and two placeholders with myptemplate_compile() and create
+ * two children from it with myptemplate_spawn() and different arguments:
+ * each must get its arguments as whole words, quotes removed and nothing
+ * expanded. - A placeholder may be the program. - An empty template, an
+ * unterminated quote, missing arguments and a destroyed template must
+ * fail with EINVAL.
  *
  * \return Nothing
  */
-void mypopentest14(
-    const char * const testname, 
+void mypopentest40(
+    const char * const testname,
     const char * const testdescription
     )
 {
+    const char * const first[] = { "first", "second word" };
+    const char * const second[] = { "$HOME", "*" };
+    const char * const program[] = { "echo" };
+    struct myptemplate tmpl;
+    char buffer[MAXLINE];
+    pid_t child;
+    int fd;
+
     ENTER();
 
     setTestName(testname, testdescription);
 
     initresources();
 
-    TRACE0("Doing mypopen(\"ls -al 2> /dev/null\", \"r\") - Should fail ...\n");
+    (void) alarm(4);
 
-    let_malloc_fail = 1;
+    TRACE0("Doing myptemplate_compile() with quotes and placeholders ...\n");
 
-    if ((fp[0] = MYCHECKEDPOPEN("ls -al 2> /dev/null", "r")) != NULL)
+    if (myptemplate_compile(&tmpl, "printf '[%s]' \"a b\" {1} '{0}' {0} x\\ y") == -1)
     {
-	let_malloc_fail = 0;
+        FAIL(MANDATORY);
+    }
 
+    if (tmpl.argc != 7 || tmpl.nargs != 2)
+    {
+        myptemplate_destroy(&tmpl);
         FAIL(MANDATORY);
     }
 
-    let_malloc_fail = 0;
+    TRACE0("Doing myptemplate_spawn() twice with different arguments ...\n");
 
-    TRACE0("Doing mypopen(\"ls -al 2> /dev/null\", \"r\") - Should now succeed ...\n");
+    if ((child = myptemplate_spawn(&tmpl, first, "r", NULL, &fd)) == -1 ||
+        readspawned(child, fd, buffer, sizeof(buffer)) != 0 ||
+        strcmp(buffer, "[a b][second word][{0}][first][x y]") != 0)
+    {
+        myptemplate_destroy(&tmpl);
+        FAIL(MANDATORY);
+    }
 
-    if ((fp[0] = MYCHECKEDPOPEN("ls -al 2> /dev/null", "r")) == NULL)
+    if ((child = myptemplate_spawn(&tmpl, second, "r", NULL, &fd)) == -1 ||
+        readspawned(child, fd, buffer, sizeof(buffer)) != 0 ||
+        strcmp(buffer, "[a b][*][{0}][$HOME][x y]") != 0)
     {
+        myptemplate_destroy(&tmpl);
         FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypclose(fp[0]) - Should succeed ...\n");
+    TRACE0("Doing myptemplate_spawn() without arguments ...\n");
 
-    if (mypclose(fp[0]) == -1)
+    errno = 0;
+
+    if (myptemplate_spawn(&tmpl, NULL, "r", NULL, &fd) != -1 || errno != EINVAL)
     {
+        myptemplate_destroy(&tmpl);
         FAIL(MANDATORY);
     }
 
-    fp[0] = NULL;
+    myptemplate_destroy(&tmpl);
+
+    errno = 0;
+
+    if (myptemplate_spawn(&tmpl, first, "r", NULL, &fd) != -1 || errno != EINVAL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    TRACE0("Doing myptemplate_compile(\"{0} hello\") ...\n");
+
+    if (myptemplate_compile(&tmpl, "{0} hello") == -1)
+    {
+        FAIL(MANDATORY);
+    }
+
+    if ((child = myptemplate_spawn(&tmpl, program, "r", NULL, &fd)) == -1 ||
+        readspawned(child, fd, buffer, sizeof(buffer)) != 0 || strcmp(buffer, "hello\n") != 0)
+    {
+        myptemplate_destroy(&tmpl);
+        FAIL(MANDATORY);
+    }
+
+    myptemplate_destroy(&tmpl);
+
+    (void) alarm(0);
+
+    TRACE0("Doing myptemplate_compile() with invalid templates ...\n");
+
+    errno = 0;
+
+    if (myptemplate_compile(&tmpl, " \t") != -1 || errno != EINVAL)
+    {
+        FAIL(MANDATORY);
+    }
+
+    errno = 0;
+
+    if (myptemplate_compile(&tmpl, "echo 'unterminated") != -1 || errno != EINVAL)
+    {
+        FAIL(MANDATORY);
+    }
 
     freeresources();
 
@@ -1762,148 +5373,149 @@ void mypopentest14(
 }
 
 /**
- * \brief Test 15
+ * \brief Test 41
  *
- * Call mypopen() with mode set to reading. Verify that stdin, stdout,
- * stderr, and the read end of the pipe are the only open file
- * descriptors after the mypopen() call.  Call mypclose(). Verify that
- * stdin, stdout, and stderr are the only open file descriptors after
- * the mypclose() call (i.e., verify that the read end of the pipe has
- * been properly closed).
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Call mypopen_ex() with MYPOPEN_SETNICE and a nice value of 5, which
+ * "nice" in the child must print, and with MYPOPEN_SETSCHED and
+ * SCHED_BATCH, which must be the policy in /proc/self/stat of the child,
+ * both together as well. - Restrict the child to CPU 0 with cpus, which
+ * must be its Cpus_allowed_list. - A policy that cannot be set
+ * (SCHED_FIFO with priority 0) must let the child exit with 1. - The
+ * caller must keep its nice value and policy.
  *
  * \return Nothing
  */
-void mypopentest15(
-    const char * const testname, 
+void mypopentest41(
+    const char * const testname,
     const char * const testdescription
     )
 {
-    int fds_allowed_open[] =
-    {
-	STDIN_FILENO,
-	STDOUT_FILENO,
-	STDERR_FILENO,
-	0
-    };
+    const char policy[] = "cut -d ' ' -f 41 /proc/self/stat";
+    struct mypopen_attr attr;
+    char buffer[MAXLINE];
+    cpu_set_t cpus;
+    int nice;
 
     ENTER();
 
     setTestName(testname, testdescription);
 
-    /* No initresources() here, since we only want stdin, stdout, stderr to be open */
+    initresources();
 
-    TRACE("Ensuring that only stdin, stdout, stderr are open ...\n");
+    errno = 0;
+    nice = getpriority(PRIO_PROCESS, 0);
 
-    /* check that pipe has been properly removed => only stdin, stdout, stderr open */
-    if (!VERIFY_CLOSED_NON_STD_FDS())
+    if (nice == -1 && errno != 0)
     {
-	bailout("File descriptors other than stdin, stdout, stderr are open");
+        bailout("Cannot get the nice value");
     }
 
-    TRACE0("Doing mypopen(\"ls -al 2> /dev/null\", \"r\") ...\n");
+    (void) alarm(4);
 
-    if ((fp[0] = MYCHECKEDPOPEN("ls -al 2> /dev/null", "r")) == NULL)
+    TRACE0("Doing mypopen_ex(\"nice\") with MYPOPEN_SETNICE and 5 ...\n");
+
+    mypopen_attr_init(&attr);
+    attr.flags = MYPOPEN_SETNICE;
+    attr.nice = 5;
+
+    if ((fp[0] = mypopen_ex("nice", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE("Verifying that only read end of pipe, stdin, stdout, and stderr are open ...\n");
+    fp[0] = NULL;
 
-    /*
-     * Verify that only fileno(fp[0]), stdin, stdout, stderr are open
-     */
-    fds_allowed_open[3] = fileno(fp[0]);
-    if (!verify_closed_file_desc(fds_allowed_open, ARRAY_SIZE(fds_allowed_open)))
+    if (strcmp(buffer, "5\n") != 0)
     {
-	FAIL(MANDATORY);
+        FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypclose(fp[0]) ...\n");
+    TRACE0("Doing mypopen_ex(\"%s\") with MYPOPEN_SETSCHED and SCHED_BATCH ...\n", policy);
 
-    if (mypclose(fp[0]) == -1)
+    attr.flags = MYPOPEN_SETSCHED;
+    attr.sched_policy = SCHED_BATCH;
+
+    if ((fp[0] = mypopen_ex(policy, "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
         FAIL(MANDATORY);
     }
 
     fp[0] = NULL;
 
-    TRACE("Verifying that only stdin, stdout, and stderr are open ...\n");
-
-    /*
-     * check that pipe has been properly removed and all other non-standard file
-     * descriptors are closed again => only stdin, stdout, stderr open
-     */
-    if (!VERIFY_CLOSED_NON_STD_FDS())
+    if (atoi(buffer) != SCHED_BATCH)
     {
-	FAIL(MANDATORY);
+        FAIL(MANDATORY);
     }
 
-    /* No freeresources() here, since we did not call initresources() */
-
-    PASS();
-
-    EXIT();
-}
+    TRACE0("Doing mypopen_ex(\"nice; %s\") with both ...\n", policy);
 
-/**
- * \brief Test 16
- *
- * Call mypopen() with mode set to reading. Verify that stdin, stdout,
- * stderr, are the only open file descriptors in the exec()'ed child process.
- * Call mypclose() and check that it succeeds.
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
- *
- * \return Nothing
- */
-void mypopentest16(
-    const char * const testname, 
-    const char * const testdescription
-    )
-{
+    attr.flags = MYPOPEN_SETSCHED | MYPOPEN_SETNICE;
+    attr.nice = 7;
 
-    char command[MAX_COMMAND_LENGTH];
-    const int verbose = getVerbose();
+    if ((fp[0] = mypopen_ex("nice; cut -d ' ' -f 41 /proc/self/stat", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || strcmp(buffer, "7\n") != 0 ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || atoi(buffer) != SCHED_BATCH)
+    {
+        FAIL(MANDATORY);
+    }
 
-    ENTER();
+    if (mypclose(fp[0]) != 0)
+    {
+        fp[0] = NULL;
+        FAIL(MANDATORY);
+    }
 
-    setTestName(testname, testdescription);
+    fp[0] = NULL;
 
-    snprintf(
-	command,
-	sizeof(command),
-	"./checkopenfds%s",
-	verbose == 1 ? " -v" : verbose >= 2 ? " -vv" : ""
-	);
-    /* No initresources() here, since we only want stdin, stdout, stderr to be open */
+    TRACE0("Doing mypopen_ex(\"grep Cpus_allowed_list /proc/self/status\") on CPU 0 ...\n");
 
-    TRACE("Ensuring that only stdin, stdout, stderr are open ...\n");
+    CPU_ZERO(&cpus);
+    CPU_SET(0, &cpus);
+    mypopen_attr_init(&attr);
+    attr.cpus = &cpus;
+    attr.cpus_size = sizeof(cpus);
 
-    /* check that pipe has been properly removed => only stdin, stdout, stderr open */
-    if (!VERIFY_CLOSED_NON_STD_FDS())
+    if ((fp[0] = mypopen_ex("grep Cpus_allowed_list /proc/self/status", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
-	bailout("File descriptors other than stdin, stdout, stderr are open");
+        FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypopen(\"%s\", \"w\") ...\n", command);
+    fp[0] = NULL;
 
-    if ((fp[0] = MYCHECKEDPOPEN(command, "w")) == NULL)
+    if (strcmp(buffer, "Cpus_allowed_list:\t0\n") != 0)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypclose(fp[0]) ...\n");
+    TRACE0("Doing mypopen_ex(\"true\") with SCHED_FIFO and priority 0 ...\n");
 
-    if (mypclose(fp[0]) != EXIT_SUCCESS)
+    mypopen_attr_init(&attr);
+    attr.flags = MYPOPEN_SETSCHED;
+    attr.sched_policy = SCHED_FIFO;
+    attr.sched_priority = 0;
+
+    if ((fp[0] = mypopen_ex("true", "r", &attr)) == NULL || mypclose(fp[0]) != 1)
     {
         FAIL(MANDATORY);
     }
 
+    (void) alarm(0);
+
     fp[0] = NULL;
 
-    /* No freeresources() here, since we did not call initresources() */
+    TRACE0("Checking the nice value and policy of the caller ...\n");
+
+    errno = 0;
+
+    if (getpriority(PRIO_PROCESS, 0) != nice || errno != 0 || sched_getscheduler(0) != SCHED_OTHER)
+    {
+        FAIL(MANDATORY);
+    }
+
+    freeresources();
 
     PASS();
 
@@ -1911,23 +5523,29 @@ void mypopentest16(
 }
 
 /**
- * \brief Test 17
+ * \brief Test 42
  *
- * Try to call mypclose() with a bogus file pointer (i.e., one that
- * has not been obtained via mypopen() but where the underlying file
- * descriptor is identical to the one of a file pointer obtained by
- * mypopen(). - This should yield an error and errno should be set to EINVAL.
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Call mypopen_ex() with limits on open files (64 soft, 128 hard) and on
+ * core files (0), which must show up in /proc/self/limits of the child
+ * and be what "ulimit -n" prints. - A soft limit above the hard one must
+ * let the child exit with 1. - The limits of the caller must stay the
+ * same.
  *
  * \return Nothing
  */
-void mypopentest17(
-    const char * const testname, 
+void mypopentest42(
+    const char * const testname,
     const char * const testdescription
     )
 {
-    FILE *fakereadfp;
+    const char command[] =
+        "awk '/^Max core file size/ { print $5, $6 } /^Max open files/ { print $4, $5 }' "
+        "/proc/self/limits; ulimit -n";
+    struct myplimit limits[2];
+    struct rlimit before, after;
+    struct mypopen_attr attr;
+    char buffer[MAXLINE];
+    size_t length;
 
     ENTER();
 
@@ -1935,56 +5553,66 @@ void mypopentest17(
 
     initresources();
 
-    TRACE0("Trying mypopen(\"cat\", \"w\") ...\n");
+    if (getrlimit(RLIMIT_NOFILE, &before) == -1)
+    {
+        bailout("Cannot get the resource limit");
+    }
 
-    if ((fp[0] = MYCHECKEDPOPEN("cat", "w")) == NULL)
+    limits[0].resource = RLIMIT_NOFILE;
+    limits[0].limit.rlim_cur = 64;
+    limits[0].limit.rlim_max = 128;
+    limits[1].resource = RLIMIT_CORE;
+    limits[1].limit.rlim_cur = 0;
+    limits[1].limit.rlim_max = 0;
+
+    mypopen_attr_init(&attr);
+    attr.limits = limits;
+    attr.nlimits = 2;
+
+    (void) alarm(4);
+
+    TRACE0("Doing mypopen_ex(\"%s\") with limits ...\n", command);
+
+    if ((fp[0] = mypopen_ex(command, "r", &attr)) == NULL)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE0("Doing fdopen(fileno(fp)) ...\n");
+    length = fread(buffer, 1, sizeof(buffer) - 1, fp[0]);
+    buffer[length] = '\0';
 
-    if ((fakereadfp = fdopen(fileno(fp[0]), "w")) == NULL)
+    if (mypclose(fp[0]) != 0)
     {
-	bailout("Cannot create fake file pointer");
+        fp[0] = NULL;
+        FAIL(MANDATORY);
     }
 
-    /*
-     * take caution here, since this might hang if passed a bogus file
-     * pointer (i.e., one not obtained via mypopen())
-     */
-
-    /*
-     * store fp in global var, so that signal handler can close it upon
-     * alarm
-     */
-    fptoclose = (volatile FILE **) &(fp[0]);
+    fp[0] = NULL;
 
-    (void) alarm(5);
+    if (strcmp(buffer, "0 0\n64 128\n64\n") != 0)
+    {
+        FAIL(MANDATORY);
+    }
 
-    TRACE0("Trying mypclose(fakereadfp) ...\n");
+    TRACE0("Doing mypopen_ex(\"true\") with a soft limit above the hard one ...\n");
 
-    errno = 0;
+    limits[0].limit.rlim_cur = 256;
+    attr.nlimits = 1;
 
-    if ((mypclose(fakereadfp) != -1)  || (errno != EINVAL))
+    if ((fp[0] = mypopen_ex("true", "r", &attr)) == NULL || mypclose(fp[0]) != 1)
     {
-        fakereadfp = NULL; /* myclose has closed this one */
-        alarmoccurred = 0;
-
         FAIL(MANDATORY);
     }
 
-    /*
-     * cancel alarm
-     */
     (void) alarm(0);
 
-    TRACE0("Checking whether mypclose() timed out ...\n");
+    fp[0] = NULL;
 
-    if (alarmoccurred == 1)
-    {
-        alarmoccurred = 0;
+    TRACE0("Checking the limits of the caller ...\n");
 
+    if (getrlimit(RLIMIT_NOFILE, &after) == -1 || after.rlim_cur != before.rlim_cur ||
+        after.rlim_max != before.rlim_max)
+    {
         FAIL(MANDATORY);
     }
 
@@ -1996,159 +5624,115 @@ void mypopentest17(
 }
 
 /**
- * \brief Test 18
+ * \brief Test 43
  *
- * Call mypopen() with mode set to writing. Verify that stdin, stdout,
- * stderr, and the read end of the pipe are the only open file
- * descriptors after the mypopen() call.  Call mypclose(). Verify that
- * stdin, stdout, and stderr are the only open file descriptors after
- * the mypclose() call (i.e., verify that the read end of the pipe has
- * been properly closed).
- * Additionally verify that mypopen() does not return for the created child
- * process, but properly invokes exit(3) in the child process.
+ * Call mypopen_ex() with MYPOPEN_SETIOPRIO and the best-effort class at
+ * level 6, which "ionice -p $$" in the child must print, and with the
+ * idle class. - A class or level out of range must let the child exit
+ * with 1. - The I/O priority of the caller must stay the same.
  *
  * \return Nothing
  */
-void mypopentest18(
-    const char * const testname, 
+void mypopentest43(
+    const char * const testname,
     const char * const testdescription
     )
 {
-    int fds_allowed_open[] =
-    {
-	STDIN_FILENO,
-	STDOUT_FILENO,
-	STDERR_FILENO,
-	0
-    };
+    struct mypopen_attr attr;
+    char buffer[MAXLINE];
+    char before[MAXLINE];
 
     ENTER();
 
     setTestName(testname, testdescription);
 
-    /* No initresources() here, since we only want stdin, stdout, stderr to be open */
+    initresources();
 
-    TRACE("Ensuring that only stdin, stdout, stderr are open ...\n");
+    (void) alarm(4);
 
-    /* check that pipe has been properly removed => only stdin, stdout, stderr open */
-    if (!VERIFY_CLOSED_NON_STD_FDS())
+    /* ionice of the caller, the shell in between has no priority set */
+    if ((fp[0] = MYCHECKEDPOPEN("ionice -p $PPID", "r")) == NULL ||
+        fgets(before, sizeof(before), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
-	bailout("File descriptors other than stdin, stdout, stderr are open");
+        FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypopen(\"grep foo 2> /dev/null\", \"w\") ...\n");
+    fp[0] = NULL;
 
-    if ((fp[0] = MYCHECKEDPOPEN("grep foo 2> /dev/null", "w")) == NULL)
+    TRACE0("Doing mypopen_ex(\"ionice -p $$\") with best-effort level 6 ...\n");
+
+    mypopen_attr_init(&attr);
+    attr.flags = MYPOPEN_SETIOPRIO;
+    attr.ioprio_class = MYPOPEN_IOPRIO_BE;
+    attr.ioprio_level = 6;
+
+    if ((fp[0] = mypopen_ex("ionice -p $$", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE("Verifying that only read end of pipe, stdin, stdout, and stderr are open ...\n");
+    fp[0] = NULL;
 
-    /*
-     * Verify that only fileno(fp[0]), stdin, stdout, stderr are open
-     */
-    fds_allowed_open[3] = fileno(fp[0]);
-    if (!verify_closed_file_desc(fds_allowed_open, ARRAY_SIZE(fds_allowed_open)))
+    if (strcmp(buffer, "best-effort: prio 6\n") != 0)
     {
-	FAIL(MANDATORY);
+        FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypclose(fp[0]) ...\n");
+    TRACE0("Doing mypopen_ex(\"ionice -p $$\") with the idle class ...\n");
 
-    if (mypclose(fp[0]) == -1)
+    attr.ioprio_class = MYPOPEN_IOPRIO_IDLE;
+    attr.ioprio_level = 0;
+
+    if ((fp[0] = mypopen_ex("ionice -p $$", "r", &attr)) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
         FAIL(MANDATORY);
     }
 
     fp[0] = NULL;
 
-    TRACE("Verifying that only stdin, stdout, and stderr are open ...\n");
-
-    /*
-     * check that pipe has been properly removed and all other non-standard file
-     * descriptors are closed again => only stdin, stdout, stderr open
-     */
-    if (!VERIFY_CLOSED_NON_STD_FDS())
+    if (strcmp(buffer, "idle\n") != 0)
     {
-	FAIL(MANDATORY);
+        FAIL(MANDATORY);
     }
 
-    /* No freeresources() here, since we did not call initresources() */
-
-    PASS();
-
-    EXIT();
-}
-
-/**
- * \brief Test 19
- *
- * Check whether mypclose() behaves properly (i.e., returns -1 and
- * sets errno to ECHLD) if waitpid() fails for reasons different from
- * EINTR.  Additionally verify that mypopen() does not return for the
- * created child process, but properly invokes exit(3) in the child
- * process.
- *
- * \return Nothing
- */
-void mypopentest19(
-    const char * const testname, 
-    const char * const testdescription
-    )
-{
-    struct sigaction ignore_sigchld;
-
-    ENTER();
-
-    setTestName(testname, testdescription);
-
-    initresources();
-
-    /*
-     * Ignore SIGCHLD => This will cause waitpid() to return -1 and set
-     * errno to ECHLD
-     */
-    memset(&ignore_sigchld, 0, sizeof(ignore_sigchld));
-    ignore_sigchld.sa_handler = SIG_IGN;
-    ignore_sigchld.sa_flags = SA_NOCLDWAIT;
+    TRACE0("Doing mypopen_ex(\"true\") with class 8 and with level 8 ...\n");
 
-    TRACE0("Installing signal handler ignoring SIGCHLD ...\n");
+    attr.ioprio_class = 8;
 
-    if (sigaction(SIGCHLD, &ignore_sigchld, 0) == -1)
+    if ((fp[0] = mypopen_ex("true", "r", &attr)) == NULL || mypclose(fp[0]) != 1)
     {
-        bailout("Cannot install signal handler");
+        FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypopen(\"exit %d\", \"r\") ...\n", EXPECTED_EXIT_STATUS);
+    attr.ioprio_class = MYPOPEN_IOPRIO_BE;
+    attr.ioprio_level = 8;
 
-    if ((fp[0] = MYCHECKEDPOPEN("exit " EXPECTED_EXIT_STATUS_STRING, "r")) == NULL)
+    if ((fp[0] = mypopen_ex("true", "r", &attr)) == NULL || mypclose(fp[0]) != 1)
     {
         FAIL(MANDATORY);
     }
 
-    TRACE0("Doing mypclose(fp[0]) ...\n");
-
-    errno = 0;
+    fp[0] = NULL;
 
-    /*
-     * take caution here, since this might hang if waitpid() fails
-     * and sets errno != EINTR
-     */
-    (void) alarm(5);
+    TRACE0("Checking the I/O priority of the caller ...\n");
 
-    if ((mypclose(fp[0]) != -1) || (errno != ECHILD))
+    if ((fp[0] = MYCHECKEDPOPEN("ionice -p $PPID", "r")) == NULL ||
+        fgets(buffer, sizeof(buffer), fp[0]) == NULL || mypclose(fp[0]) != 0)
     {
         FAIL(MANDATORY);
     }
 
-    /*
-     * cancel alarm
-     */
     (void) alarm(0);
 
     fp[0] = NULL;
 
+    if (strcmp(buffer, before) != 0)
+    {
+        FAIL(MANDATORY);
+    }
+
     freeresources();
 
     PASS();
@@ -2157,22 +5741,31 @@ void mypopentest19(
 }
 
 /**
- * \brief Test 20
+ * \brief Test 44
  *
- * Do a mypopen() with a really long commandline that causes execl() to
- * fail and set errno to E2BIG. - Check whether mypopen() is successful
- * anyway (i.e., returns something != NULL). Additionally verify that
- * mypopen() does not return for the created child process, but
- * properly invokes exit(3) in the child process.
+ * Count the allocations of the size of a stream buffer while calling
+ * mypopen(), fgets() and mypclose() 10 times: only the first stream may
+ * allocate its buffer, the others must reuse it. - Read a line of 10001
+ * bytes with mypline_next() and a buffer of 4096 bytes, which grows the
+ * buffer to 16384 bytes, and then initialize a reader with 16384 bytes:
+ * the grown buffer must be reused and return the next line unchanged.
  *
  * \return Nothing
  */
-void mypopentest20(
-    const char * const testname, 
+void mypopentest44(
+    const char * const testname,
     const char * const testdescription
     )
 {
-    char command[REALLY_LONG_COMMAND_LENGTH];
+    const char command[] = "head -c 10000 /dev/zero | tr '\\0' x; echo";
+    struct mypline_reader reader;
+    const char *line;
+    ssize_t length;
+    pid_t child;
+    int valid;
+    int lines;
+    int fd;
+    int i;
 
     ENTER();
 
@@ -2180,15 +5773,69 @@ void mypopentest20(
 
     initresources();
 
-    memset(command, 'x', sizeof(command));
+    (void) alarm(4);
 
-    TRACE0("Trying mypopen(\"%s\", \"r\") ...\n", command);
+    TRACE0("Doing mypopen(\"echo reused\") 10 times counting allocations of 8192 bytes ...\n");
 
-    if ((fp[0] = MYCHECKEDPOPEN(command, "r")) == NULL)
+    counted_mallocs = 0;
+    counted_size = 8192;
+
+    for (i = 0; i < 10; i++)
+    {
+        if (readcommand("echo reused", &lines) != 0 || lines != 1)
+        {
+            counted_size = 0;
+            fp[0] = NULL;
+            FAIL(MANDATORY);
+        }
+
+        fp[0] = NULL;
+    }
+
+    counted_size = 0;
+
+    if (counted_mallocs != 1)
     {
         FAIL(MANDATORY);
     }
 
+    for (i = 0; i < 2; i++)
+    {
+        TRACE0("Doing mypline_next() on \"%s\" with a buffer of %d bytes ...\n", command,
+               i == 0 ? 4096 : 16384);
+
+        if ((child = mypspawn(command, "r", NULL, &fd)) == -1)
+        {
+            FAIL(MANDATORY);
+        }
+
+        counted_mallocs = 0;
+        counted_size = 16384;
+
+        if (mypline_init(&reader, fd, i == 0 ? 4096 : 16384) == -1)
+        {
+            counted_size = 0;
+            FAIL(MANDATORY);
+        }
+
+        counted_size = 0;
+
+        length = mypline_next(&reader, &line);
+        valid = length == 10001 && line[0] == 'x' && line[10000] == '\n' &&
+                reader.size == 16384;
+
+        mypline_destroy(&reader);
+
+        (void) close(fd);
+
+        if (waitpid(child, NULL, 0) != child || !valid || (i == 1 && counted_mallocs != 0))
+        {
+            FAIL(MANDATORY);
+        }
+    }
+
+    (void) alarm(0);
+
     freeresources();
 
     PASS();
@@ -2219,6 +5866,30 @@ static const struct test all_tests[] = {
     X(mypopentest18),
     X(mypopentest19),
     X(mypopentest20),
+    X(mypopentest21),
+    X(mypopentest22),
+    X(mypopentest23),
+    X(mypopentest24),
+    X(mypopentest25),
+    X(mypopentest26),
+    X(mypopentest27),
+    X(mypopentest28),
+    X(mypopentest29),
+    X(mypopentest30),
+    X(mypopentest31),
+    X(mypopentest32),
+    X(mypopentest33),
+    X(mypopentest34),
+    X(mypopentest35),
+    X(mypopentest36),
+    X(mypopentest37),
+    X(mypopentest38),
+    X(mypopentest39),
+    X(mypopentest40),
+    X(mypopentest41),
+    X(mypopentest42),
+    X(mypopentest43),
+    X(mypopentest44),
 #undef X
 };
 
@@ -2244,6 +5915,11 @@ int main(
 {
     int c;
     const char *coloring = "auto";
+    unsigned long int maxjobs = 0;
+    const struct test *tests[ARRAY_SIZE(all_tests)];
+    const struct test **selected = tests;
+    size_t ntests = 0;
+    size_t i;
 
     cmd = argv[0];
 
@@ -2257,10 +5933,11 @@ int main(
         { .name = "verbose",	.has_arg = no_argument,		.flag = NULL, .val = 'v' },
         { .name = "description",.has_arg = no_argument,		.flag = NULL, .val = 'd' },
         { .name = "color",	.has_arg = required_argument,	.flag = NULL, .val = 'c' },
+        { .name = "jobs",	.has_arg = required_argument,	.flag = NULL, .val = 'j' },
         { .name = NULL,	},
     };
                
-    while ((c = getopt_long(argc, argv, "vdc:", long_opts, NULL)) != EOF)
+    while ((c = getopt_long(argc, argv, "vdc:j:", long_opts, NULL)) != EOF)
     {
         switch(c)
         {
@@ -2276,6 +5953,18 @@ int main(
             coloring = optarg;
             break;
 
+        case 'j':
+        {
+            char *endptr;
+
+            maxjobs = strtoul(optarg, &endptr, 0);
+            if (*endptr != '\0' || endptr == optarg || maxjobs == 0 || maxjobs > UINT_MAX)
+            {
+                usage();
+            }
+            break;
+        }
+
         default:
             usage();
             break;
@@ -2302,20 +5991,26 @@ int main(
      */
     (void) signal(SIGPIPE, SIG_IGN);
 
-    /* execute tests */
+    /* select tests */
     if (argc == optind)
     {
         /* No parameters: do all as before */
-        unsigned int i;
         for (i = 0; i < ARRAY_SIZE(all_tests); i++)
         {
-            spawn(&all_tests[i]);
+            tests[ntests++] = &all_tests[i];
         }
     }
     else
     {
         /* Loop over the args */
         char **arg;
+
+        if ((size_t) (argc - optind) > ARRAY_SIZE(tests) &&
+            (selected = calloc(argc - optind, sizeof(*selected))) == NULL)
+        {
+            bailout("Cannot allocate list of tests");
+        }
+
         for (arg = argv+optind; *arg != NULL; arg++)
         {
             char *endptr;
@@ -2330,10 +6025,28 @@ int main(
                 errno = 0;
                 bailout("Invalid test number outside from [%d..%zu]\n", 0, ARRAY_SIZE(all_tests)-1);
             }
-            
-            spawn(&all_tests[num]);
+
+            selected[ntests++] = &all_tests[num];
+        }
+    }
+
+    /* execute tests */
+    if (maxjobs == 0)
+    {
+        for (i = 0; i < ntests; i++)
+        {
+            spawn(selected[i]);
         }
     }
+    else
+    {
+        spawnparallel(selected, ntests, maxjobs);
+    }
+
+    if (selected != tests)
+    {
+        free(selected);
+    }
 
     freeresources();
 
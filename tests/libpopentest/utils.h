@@ -129,9 +129,10 @@ extern void bailout(
  * verify that all file descriptors except those provided as arguments are
  * closed.
  *
- * note: FD_SETSIZE (see select()) is used as maximum number of
- * open file descriptors even the system may support an higher number
- * of open files.
+ * note: the open file descriptors are enumerated via /proc/self/fd, so the
+ * check takes time proportional to the number of open file descriptors and
+ * covers every file descriptor number. - If /proc is not available, every
+ * file descriptor below the RLIMIT_NOFILE soft limit is probed instead.
  *
  * \param fds_allowed_open array of file descriptors that are allowed to be open
  * \param num_fds number of elements in the \a fds_allowed_open array
@@ -0,0 +1,100 @@
+/**
+ * @file test-coro.cpp
+ * Run children through the coroutine reactor of mypopen_coro.hpp: several
+ * children whose output is read, one whose input is written and one exiting
+ * with a status, all awaited at the same time on one thread.
+ *
+ * Usage: test-coro
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <sys/wait.h>
+
+#include "../../src/mypopen_coro.hpp"
+
+/* more than fits in a pipe, so the writer has to be suspended */
+#define INPUT_SIZE (256 * 1024)
+
+static int failures = 0;
+static int finished = 0;
+
+static void check(bool ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "test-coro: %s failed\n", what);
+    ++failures;
+  }
+}
+
+/**
+ * @brief read the whole output of a child and check it and the exit status
+ */
+static mypp::task read_child(mypp::reactor &loop, const char *command, std::string expected,
+                             int status) {
+  auto child = mypp::process::spawn(loop, command, "r");
+  std::string output;
+  char buffer[4096];
+  ssize_t n;
+
+  check(static_cast<bool>(child), command);
+  while ((n = co_await child.read(buffer, sizeof(buffer))) > 0) {
+    output.append(buffer, static_cast<std::size_t>(n));
+  }
+  ssize_t wstatus = co_await child.exit();
+
+  check(n == 0 && output == expected, command);
+  check(wstatus != -1 && WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == status, command);
+  ++finished;
+}
+
+/**
+ * @brief write to a child that checks it has got all of the input
+ */
+static mypp::task write_child(mypp::reactor &loop) {
+  static char input[INPUT_SIZE];
+  std::string command = "test \"$(wc -c)\" -eq " + std::to_string(sizeof(input));
+  auto child = mypp::process::spawn(loop, command.c_str(), "w");
+
+  check(static_cast<bool>(child), "spawning the writer");
+  ssize_t n = co_await child.write(input, sizeof(input));
+  ssize_t wstatus = co_await child.exit();
+
+  check(n == static_cast<ssize_t>(sizeof(input)), "writing to the child");
+  check(wstatus != -1 && WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0, "the input of the child");
+  ++finished;
+}
+
+int main() {
+  mypp::reactor loop;
+
+  if (!loop) {
+    perror("epoll_create1");
+    return EXIT_FAILURE;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  read_child(loop, "sleep 0.3; echo a", "a\n", 0);
+  read_child(loop, "sleep 0.3; echo b", "b\n", 0);
+  read_child(loop, "sleep 0.3; seq 1 3", "1\n2\n3\n", 0);
+  read_child(loop, "echo c; exit 42", "c\n", 42);
+  write_child(loop);
+
+  if (loop.run() == -1) {
+    perror("reactor::run");
+    return EXIT_FAILURE;
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  check(finished == 5, "awaiting all children");
+  /* the children sleeping 0.3 s run at the same time */
+  check(elapsed < std::chrono::milliseconds(800), "running the children concurrently");
+
+  if (failures > 0) {
+    return EXIT_FAILURE;
+  }
+  printf("test-coro: %d children awaited\n", finished);
+  return EXIT_SUCCESS;
+}
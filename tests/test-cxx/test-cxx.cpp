@@ -0,0 +1,249 @@
+/**
+ * @file test-cxx.cpp
+ * Check the C++ wrappers of mypopen.hpp and mypopen_streambuf.hpp: moving
+ * and reaping mypp::Process, and reading and writing through mypp::pipebuf
+ * with buffers small enough for every path of underflow, overflow and sync
+ * to be taken.
+ *
+ * Usage: test-cxx
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../../src/mypopen.hpp"
+#include "../../src/mypopen_streambuf.hpp"
+
+/* more than fits in a pipe, so the other side has to keep up */
+#define BIG_SIZE (256 * 1024)
+
+static int failures = 0;
+static int checks = 0;
+
+static void check(bool ok, const char *what) {
+  ++checks;
+  if (!ok) {
+    fprintf(stderr, "test-cxx: %s failed\n", what);
+    ++failures;
+  }
+}
+
+/**
+ * @returns whether the calling process has no child left to reap
+ */
+static bool no_children() { return waitpid(-1, nullptr, WNOHANG) == -1 && errno == ECHILD; }
+
+/**
+ * @brief read everything from an input stream
+ */
+static std::string slurp(std::istream &in) {
+  std::string data;
+  char c;
+
+  while (in.get(c)) {
+    data += c;
+  }
+  return data;
+}
+
+static void test_process_move() {
+  mypp::Process empty;
+
+  check(!empty && empty.stream() == nullptr && empty.wait() == -1, "an empty process");
+
+  auto process = mypp::Process::open("echo moved; exit 3", "r");
+  check(static_cast<bool>(process), "opening a process");
+
+  mypp::Process moved(std::move(process));
+  check(!process && process.stream() == nullptr, "the process moved from");
+  check(static_cast<bool>(moved) && moved.stream() != nullptr, "the process moved to");
+
+  mypp::Process assigned;
+  assigned = std::move(moved);
+  check(!moved && static_cast<bool>(assigned), "moving by assignment");
+
+  mypp::Process &self = assigned;
+  assigned = std::move(self);
+  check(static_cast<bool>(assigned), "moving a process to itself");
+
+  char line[16];
+  check(fgets(line, sizeof(line), assigned.stream()) != nullptr && std::string(line) == "moved\n",
+        "reading from the process moved to");
+  check(assigned.wait() == 3 && !assigned && assigned.result() == 3 &&
+            WIFEXITED(assigned.wstatus()) && WEXITSTATUS(assigned.wstatus()) == 3,
+        "waiting for the process moved to");
+  check(assigned.wait() == 3, "waiting twice");
+
+  /* assigning over a process that has been waited for has nothing to wait for */
+  assigned = mypp::Process::open("exit 4", "r");
+  check(static_cast<bool>(assigned) && assigned.wait() == 4, "assigning over a waited process");
+  check(no_children(), "reaping the moved processes");
+}
+
+static void test_process_destructor() {
+  {
+    auto process = mypp::Process::open("exec sleep 0.1", "r");
+
+    check(static_cast<bool>(process), "opening a process left to the destructor");
+  }
+  check(no_children(), "reaping by the destructor");
+
+  /* only one stream can be open at a time, which the destructor must have closed */
+  auto first = mypp::Process::open("true", "r");
+  auto second = mypp::Process::open("true", "r");
+  check(static_cast<bool>(first), "opening after the destructor");
+  check(!second && second.error() == EAGAIN, "opening a second process");
+  check(first.wait() == 0 && first.error() == 0, "waiting for the first process");
+}
+
+static void test_process_signals() {
+  auto process = mypp::Process::open("exec sleep 5", "r");
+
+  check(process.wait_for(50) == -1 && process.error() == ETIMEDOUT &&
+            WIFSIGNALED(process.wstatus()) && WTERMSIG(process.wstatus()) == SIGTERM,
+        "waiting with a deadline");
+
+  process = mypp::Process::open("exec sleep 5", "r");
+  check(process.kill(SIGKILL) == 0, "killing a process");
+  check(process.wait() == -1 && WIFSIGNALED(process.wstatus()) &&
+            WTERMSIG(process.wstatus()) == SIGKILL,
+        "waiting for a killed process");
+  check(process.kill(SIGKILL) == -1 && process.error() != 0, "killing a process waited for");
+
+  process = mypp::Process::open("exec sleep 5", "r");
+  check(process.abort() == -1 && WIFSIGNALED(process.wstatus()) && !process,
+        "aborting a process");
+  check(no_children(), "reaping the signalled processes");
+}
+
+static void test_pipebuf_read() {
+  auto process = mypp::Process::open("printf abc", "r");
+  {
+    /* a buffer of one byte has to be refilled by underflow for every byte */
+    mypp::pipebuf buffer(process.stream(), 1);
+    std::istream in(&buffer);
+
+    check(in.peek() == 'a', "peeking at the first byte");
+    check(slurp(in) == "abc", "reading byte by byte");
+    check(buffer.sgetc() == std::char_traits<char>::eof(), "reading past the end");
+    check(buffer.pubsync() == 0, "syncing a reading buffer");
+    check(buffer.sputc('x') == std::char_traits<char>::eof(), "writing to a reading buffer");
+  }
+  check(process.wait() == 0, "waiting for the reader");
+
+  /* one byte is buffered, the bulk goes around the buffer and the tail refills it */
+  process = mypp::Process::open("head -c 262144 /dev/zero | tr '\\0' x", "r");
+  {
+    static char data[BIG_SIZE + 1];
+    mypp::pipebuf buffer(process.stream(), 4096);
+    std::istream in(&buffer);
+    std::string all;
+
+    check(in.get() == 'x', "reading the first byte");
+    in.read(data, BIG_SIZE - 100);
+    check(in.gcount() == BIG_SIZE - 100, "reading in bulk");
+    all.assign(data, static_cast<std::size_t>(in.gcount()));
+    in.read(data, 1000);
+    check(in.gcount() == 99 && in.eof(), "reading the rest in bulk");
+    all.append(data, static_cast<std::size_t>(in.gcount()));
+    check(all == std::string(BIG_SIZE - 1, 'x'), "the bytes read in bulk");
+  }
+  check(process.wait() == 0, "waiting for the bulk reader");
+}
+
+static void test_pipebuf_write() {
+  /* a buffer of one byte has to be flushed by overflow for every byte */
+  auto process = mypp::Process::open("test \"$(cat)\" = abc", "w");
+  {
+    mypp::pipebuf buffer(process.stream(), 1);
+    std::ostream out(&buffer);
+
+    out << "abc";
+    check(static_cast<bool>(out), "writing byte by byte");
+    check(buffer.sgetc() == std::char_traits<char>::eof(), "reading from a writing buffer");
+  }
+  check(process.wait() == 0, "the bytes written byte by byte");
+
+  /* small writes are buffered, a big one goes out together with them */
+  std::string big(BIG_SIZE, 'y');
+  std::string command = "test \"$(wc -c)\" -eq " + std::to_string(big.size() + 5);
+  process = mypp::Process::open(command.c_str(), "w");
+  {
+    mypp::pipebuf buffer(process.stream(), 4096);
+    std::ostream out(&buffer);
+
+    out << "hello";
+    out.write(big.data(), static_cast<std::streamsize>(big.size()));
+    check(static_cast<bool>(out), "writing in bulk");
+  }
+  check(process.wait() == 0, "the bytes written in bulk");
+}
+
+static void test_pipebuf_sync() {
+  char path[] = "/tmp/test-cxx.XXXXXX";
+  int fd = mkstemp(path);
+  struct stat st = {};
+
+  check(fd != -1, "creating a temporary file");
+  close(fd);
+
+  /* the child only sees what sync sends while the buffer is still alive */
+  std::string command = std::string("head -c 5 > ") + path;
+  auto process = mypp::Process::open(command.c_str(), "w");
+  {
+    mypp::pipebuf buffer(process.stream());
+    std::ostream out(&buffer);
+    struct timespec delay = {0, 10 * 1000 * 1000L};
+    int i;
+
+    out << "hello";
+    check(buffer.pubsync() == 0, "syncing a writing buffer");
+    for (i = 0; i < 200 && (stat(path, &st) == -1 || st.st_size < 5); ++i) {
+      nanosleep(&delay, nullptr);
+    }
+    check(st.st_size == 5, "the bytes sent by sync");
+  }
+  check(process.wait() == 0, "waiting for the synced child");
+  unlink(path);
+
+  /* once the child is gone, flushing has to fail instead of raising SIGPIPE */
+  process = mypp::Process::open("exit 0", "w");
+  {
+    mypp::pipebuf buffer(process.stream(), 1);
+    std::ostream out(&buffer);
+    struct timespec delay = {0, 100 * 1000 * 1000L};
+
+    nanosleep(&delay, nullptr);
+    out << "ab" << std::flush;
+    check(out.bad(), "writing to a child that is gone");
+  }
+  check(process.wait() == 0, "waiting for the child that is gone");
+}
+
+int main() {
+  signal(SIGPIPE, SIG_IGN);
+
+  test_process_move();
+  test_process_destructor();
+  test_process_signals();
+  test_pipebuf_read();
+  test_pipebuf_write();
+  test_pipebuf_sync();
+
+  if (failures > 0) {
+    return EXIT_FAILURE;
+  }
+  printf("test-cxx: %d checks passed\n", checks);
+  return EXIT_SUCCESS;
+}
@@ -203,6 +203,9 @@ int main(
     char command[CMDLEN];
     char type[TYPELEN];
     char line[LINELEN];
+    struct mypline_reader reader;
+    const char *readerline;
+    ssize_t length;
     flowdir_t flowdir = DIR_NONE;
     unsigned long countchars = 0;
     FILE *input, *output;
@@ -275,19 +278,56 @@ int main(
             assert(0);
     }
 
-    while (fgets(line, sizeof(line), input) != NULL)
+    if (flowdir == DIR_READ)
     {
-        if (fputs(line, output) == EOF)
+        /*
+         * the lines are read from the pipe directly, so they are neither
+         * copied nor split, however long they are
+         */
+        if (mypline_init(&reader, fileno(input), 0) == -1)
         {
-            bailout("Cannot write to output stream");
+            bailout("Cannot allocate line buffer");
         }
 
-        if (fflush(output) == EOF)
+        while ((length = mypline_next(&reader, &readerline)) > 0)
         {
-            bailout("Cannot flush output stream");
+            if (fwrite(readerline, 1, length, output) != (size_t) length)
+            {
+                bailout("Cannot write to output stream");
+            }
+
+            if (fflush(output) == EOF)
+            {
+                bailout("Cannot flush output stream");
+            }
+
+            countchars += length;
+        }
+
+        if (length == -1)
+        {
+            bailout("Cannot read from input stream");
         }
 
-        countchars += strlen(line);
+        mypline_destroy(&reader);
+    }
+    else
+    {
+        /* stdin has been read via stdio already, so it has to stay that way */
+        while (fgets(line, sizeof(line), input) != NULL)
+        {
+            if (fputs(line, output) == EOF)
+            {
+                bailout("Cannot write to output stream");
+            }
+
+            if (fflush(output) == EOF)
+            {
+                bailout("Cannot flush output stream");
+            }
+
+            countchars += strlen(line);
+        }
     }
 
     if (ferror(fp))
@@ -23,7 +23,11 @@
 #include <stdarg.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
 
 #include "utils.h"
 
@@ -144,57 +148,133 @@ void bailout(
 }
 
 /**
- * verify that all file descriptors except those provided as arguments are
- * closed.
+ * check whether a file descriptor is contained in a list of file descriptors
  *
- * note: FD_SETSIZE (see select()) is used as maximum number of
- * open file descriptors even the system may support an higher number
- * of open files.
+ * \param fd the file descriptor to look for
+ * \param fds array of file descriptors
+ * \param num_fds number of elements in the \a fds array
+ */
+static int contains_file_desc(
+        const int fd,
+        const int *fds,
+        const size_t num_fds
+)
+{
+    size_t j;
+
+    for (j = 0; j < num_fds; ++j)
+    {
+        if (fd == fds[j])
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * verify that all file descriptors below the RLIMIT_NOFILE soft limit except
+ * those provided as arguments are closed by probing each one of them.
+ *
+ * This is the fallback used if /proc/self/fd cannot be read.
  *
  * \param fds_allowed_open array of file descriptors that are allowed to be open
  * \param num_fds number of elements in the \a fds_allowed_open array
  */
-int verify_closed_file_desc(
+static int verify_closed_file_desc_probe(
         const int *fds_allowed_open,
         size_t num_fds
 )
 {
-    int i;
-    struct stat statbuf;
+    struct rlimit openfiles;
+    rlim_t max_fd = FD_SETSIZE;
+    rlim_t i;
 
-    for (i = 0; i < FD_SETSIZE; ++i)
+    if (getrlimit(RLIMIT_NOFILE, &openfiles) == 0 && openfiles.rlim_cur != RLIM_INFINITY)
     {
-        int allowed_open = 0;
-        int j;
+        max_fd = openfiles.rlim_cur;
+    }
 
-        for (j = 0; j < (int) num_fds; ++j)
+    for (i = 0; i < max_fd; ++i)
+    {
+        if (contains_file_desc((int) i, fds_allowed_open, num_fds))
         {
-            if (i == fds_allowed_open[j])
-            {
-                allowed_open = 1;
-                break;
-            }
+            continue;
         }
 
+        TRACE2("Checking if file descriptor %d is open ...\n", (int) i);
+
         errno = 0;
 
-        if (!allowed_open)
+        if ((fcntl((int) i, F_GETFD) != -1) || (errno != EBADF))
         {
-            TRACE2("Checking if file descriptor %d is open ...\n", i);
+            TRACE("File descriptor %d is open but should be closed\n", (int) i);
 
-            if ((fstat(i, &statbuf) == 0) || (errno != EBADF))
-            {
+            return 0;
+        }
+    }
 
-                TRACE("File descriptor %d is open but should be closed\n", i);
+    errno = 0;
 
-                return 0;
-            }
+    return 1;
+}
+
+/**
+ * verify that all file descriptors except those provided as arguments are
+ * closed.
+ *
+ * note: the open file descriptors are enumerated via /proc/self/fd, so the
+ * check takes time proportional to the number of open file descriptors and
+ * covers every file descriptor number. - If /proc is not available, every
+ * file descriptor below the RLIMIT_NOFILE soft limit is probed instead.
+ *
+ * \param fds_allowed_open array of file descriptors that are allowed to be open
+ * \param num_fds number of elements in the \a fds_allowed_open array
+ */
+int verify_closed_file_desc(
+        const int *fds_allowed_open,
+        size_t num_fds
+)
+{
+    DIR *dir;
+    struct dirent *entry;
+    int result = 1;
+
+    if ((dir = opendir("/proc/self/fd")) == NULL)
+    {
+        TRACE("Cannot open /proc/self/fd - probing all file descriptors ...\n");
+
+        return verify_closed_file_desc_probe(fds_allowed_open, num_fds);
+    }
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        char *endptr;
+        const long fd = strtol(entry->d_name, &endptr, 10);
+
+        /* skip "." and ".." and the file descriptor used for reading the directory */
+        if (*endptr != '\0' || endptr == entry->d_name || fd == dirfd(dir))
+        {
+            continue;
         }
 
-        errno = 0;
+        TRACE2("Checking if file descriptor %ld may be open ...\n", fd);
+
+        if (!contains_file_desc((int) fd, fds_allowed_open, num_fds))
+        {
+            TRACE("File descriptor %ld is open but should be closed\n", fd);
+
+            result = 0;
+            break;
+        }
     }
 
-    return 1;
+    (void) closedir(dir);
+
+    errno = 0;
+
+    return result;
 }
 
 /*